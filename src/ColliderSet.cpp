@@ -0,0 +1,259 @@
+#include "ColliderSet.h"
+#include "Shader.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+
+namespace {
+	constexpr float maximumCellsPerAxis = 16.f;
+
+	// Transform moving y axis to the given direction and origin to the given point
+	glm::mat4 makeFrame(const glm::vec3& origin, const glm::vec3& yAxis)
+	{
+		const glm::vec3 helper = glm::abs(yAxis.y) < 0.99f ? glm::vec3(0.f, 1.f, 0.f) : glm::vec3(1.f, 0.f, 0.f);
+		const glm::vec3 xAxis = glm::normalize(glm::cross(helper, yAxis));
+		const glm::vec3 zAxis = glm::cross(xAxis, yAxis);
+		return glm::mat4(glm::vec4(xAxis, 0.f), glm::vec4(yAxis, 0.f), glm::vec4(zAxis, 0.f), glm::vec4(origin, 1.f));
+	}
+
+	ColliderSet::Collider makeCollider(ColliderSet::Type type, const glm::mat4& transform, const glm::vec4& shape)
+	{
+		ColliderSet::Collider collider{};
+		collider.transform = transform;
+		collider.inverseTransform = glm::inverse(transform);
+		collider.previousTransform = collider.transform;
+		collider.previousInverseTransform = collider.inverseTransform;
+		collider.shape = shape;
+		collider.type = type;
+		return collider;
+	}
+
+	// Half extents of the collider in its own space
+	glm::vec3 getLocalExtents(const ColliderSet::Collider& collider)
+	{
+		switch (collider.type)
+		{
+			case ColliderSet::Type::CAPSULE:
+				return glm::vec3(collider.shape.y, collider.shape.x + collider.shape.y, collider.shape.y);
+
+			case ColliderSet::Type::BOX:
+				return glm::vec3(collider.shape);
+
+			default:
+				return glm::vec3(collider.shape.x);
+		}
+	}
+}
+
+ColliderSet::Collider ColliderSet::makePlane(const glm::vec3& point, const glm::vec3& normal)
+{
+	return makeCollider(Type::PLANE, makeFrame(point, glm::normalize(normal)), glm::vec4(0.f));
+}
+
+ColliderSet::Collider ColliderSet::makeSphere(const glm::vec3& center, float radius)
+{
+	return makeCollider(Type::SPHERE, glm::translate(glm::mat4(1.f), center), glm::vec4(radius, 0.f, 0.f, 0.f));
+}
+
+ColliderSet::Collider ColliderSet::makeCapsule(const glm::vec3& start, const glm::vec3& end, float radius)
+{
+	const float length = glm::length(end - start);
+	const glm::vec3 axis = length > 0.f ? (end - start) / length : glm::vec3(0.f, 1.f, 0.f);
+	return makeCollider(Type::CAPSULE, makeFrame(0.5f * (start + end), axis), glm::vec4(0.5f * length, radius, 0.f, 0.f));
+}
+
+ColliderSet::Collider ColliderSet::makeBox(const glm::mat4& transform, const glm::vec3& halfExtents)
+{
+	return makeCollider(Type::BOX, transform, glm::vec4(halfExtents, 0.f));
+}
+
+ColliderSet::Collider ColliderSet::makeEllipsoid(const glm::mat4& transform, float radius)
+{
+	return makeCollider(Type::ELLIPSOID, transform, glm::vec4(radius, 0.f, 0.f, 0.f));
+}
+
+ColliderSet::ColliderSet()
+{
+	update();
+}
+
+ColliderSet::~ColliderSet()
+{
+	glDeleteBuffers(1, &colliderBuffer);
+	glDeleteBuffers(1, &cellBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+}
+
+uint32_t ColliderSet::add(const Collider& collider)
+{
+	colliders.push_back(collider);
+	enabled.push_back(1);
+	changed = true;
+	return (uint32_t)colliders.size() - 1;
+}
+
+void ColliderSet::set(uint32_t index, const Collider& collider)
+{
+	colliders[index] = collider;
+	changed = true;
+}
+
+void ColliderSet::setEnabled(uint32_t index, bool enable)
+{
+	if (isEnabled(index) == enable)
+		return;
+
+	enabled[index] = enable ? 1 : 0;
+	changed = true;
+}
+
+void ColliderSet::setMargin(float distance)
+{
+	margin = glm::max(distance, 0.f);
+	changed = true;
+}
+
+bool ColliderSet::update()
+{
+	if (!changed && !moving)
+		return false;
+
+	// Colliders added since the last update start at rest
+	moving = false;
+	for (size_t i = 0; i < colliders.size(); ++i)
+	{
+		Collider& collider = colliders[i];
+		const glm::mat4& previousTransform = i < simulatedTransforms.size() ? simulatedTransforms[i] : collider.transform;
+		if (previousTransform != collider.previousTransform)
+		{
+			collider.previousTransform = previousTransform;
+			collider.previousInverseTransform = glm::inverse(previousTransform);
+		}
+
+		moving = moving || (enabled[i] && collider.previousTransform != collider.transform);
+	}
+
+	simulatedTransforms.resize(colliders.size());
+	for (size_t i = 0; i < colliders.size(); ++i)
+		simulatedTransforms[i] = colliders[i].transform;
+
+	std::vector<glm::uvec2> cells;
+	std::vector<uint32_t> indices;
+	buildGrid(cells, indices);
+	upload(colliderBuffer, colliderCapacity, colliders.data(), colliders.size() * sizeof(Collider));
+	upload(cellBuffer, cellCapacity, cells.data(), cells.size() * sizeof(glm::uvec2));
+	upload(indexBuffer, indexCapacity, indices.data(), indices.size() * sizeof(uint32_t));
+	changed = false;
+	return true;
+}
+
+void ColliderSet::resetMotion()
+{
+	simulatedTransforms.resize(colliders.size());
+	for (size_t i = 0; i < colliders.size(); ++i)
+		simulatedTransforms[i] = colliders[i].transform;
+
+	changed = true;
+}
+
+void ColliderSet::bind(const Shader& shader) const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, colliderBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, cellBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, indexBuffer);
+	shader.setUint("colliderPlaneCount", planeCount);
+	shader.setVec3("colliderGridMinimum", gridMinimum);
+	shader.setFloat("colliderCellSize", cellSize);
+	shader.setUvec3("colliderGridResolution", gridResolution);
+}
+
+void ColliderSet::buildGrid(std::vector<glm::uvec2>& cells, std::vector<uint32_t>& indices)
+{
+	// World space bounds of every enabled collider over the whole step, extended by the margin
+	std::vector<uint32_t> bounded;
+	std::vector<glm::vec3> minimums, maximums;
+	glm::vec3 boundsMinimum(0.f), boundsMaximum(0.f);
+	planeCount = 0;
+	for (uint32_t i = 0; i < colliders.size(); ++i)
+	{
+		if (!enabled[i])
+			continue;
+
+		if (colliders[i].type == Type::PLANE)
+		{
+			indices.push_back(i);
+			++planeCount;
+			continue;
+		}
+
+		const glm::vec3 localExtents = getLocalExtents(colliders[i]);
+		auto getExtents = [&localExtents, this](const glm::mat4& transform) {
+			return glm::abs(glm::vec3(transform[0])) * localExtents.x + glm::abs(glm::vec3(transform[1])) * localExtents.y
+				+ glm::abs(glm::vec3(transform[2])) * localExtents.z + margin;
+		};
+
+		const glm::vec3 previousCenter(colliders[i].previousTransform[3]), center(colliders[i].transform[3]);
+		const glm::vec3 previousExtents = getExtents(colliders[i].previousTransform), extents = getExtents(colliders[i].transform);
+		const glm::vec3 colliderMinimum = glm::min(previousCenter - previousExtents, center - extents);
+		const glm::vec3 colliderMaximum = glm::max(previousCenter + previousExtents, center + extents);
+
+		boundsMinimum = bounded.empty() ? colliderMinimum : glm::min(boundsMinimum, colliderMinimum);
+		boundsMaximum = bounded.empty() ? colliderMaximum : glm::max(boundsMaximum, colliderMaximum);
+		bounded.push_back(i);
+		minimums.push_back(colliderMinimum);
+		maximums.push_back(colliderMaximum);
+	}
+
+	gridMinimum = boundsMinimum;
+	gridResolution = glm::uvec3(0);
+	if (bounded.empty())
+		return;
+
+	// Cubic cells, the longest side of bounds is split into maximumCellsPerAxis cells
+	const glm::vec3 boundsSize = boundsMaximum - boundsMinimum;
+	cellSize = glm::max(glm::max(boundsSize.x, glm::max(boundsSize.y, boundsSize.z)) / maximumCellsPerAxis, 1e-4f);
+	gridResolution = glm::uvec3(glm::clamp(glm::ceil(boundsSize / cellSize), glm::vec3(1.f), glm::vec3(maximumCellsPerAxis)));
+	auto toCell = [this](const glm::vec3& position) {
+		return glm::min(glm::uvec3(glm::max((position - gridMinimum) / cellSize, glm::vec3(0.f))), gridResolution - 1U);
+	};
+
+	// Colliders are counted per cell first, then their indices are written at prefix sums of counts
+	cells.assign((size_t)gridResolution.x * gridResolution.y * gridResolution.z, glm::uvec2(0));
+	auto forEachCell = [&](size_t collider, auto function) {
+		const glm::uvec3 lowest = toCell(minimums[collider]), highest = toCell(maximums[collider]);
+		for (uint32_t z = lowest.z; z <= highest.z; ++z)
+			for (uint32_t y = lowest.y; y <= highest.y; ++y)
+				for (uint32_t x = lowest.x; x <= highest.x; ++x)
+					function(((size_t)z * gridResolution.y + y) * gridResolution.x + x);
+	};
+
+	for (size_t i = 0; i < bounded.size(); ++i)
+		forEachCell(i, [&cells](size_t cell) { ++cells[cell].y; });
+
+	uint32_t offset = (uint32_t)indices.size();
+	for (auto& cell : cells)
+	{
+		cell.x = offset;
+		offset += cell.y;
+		cell.y = 0;
+	}
+
+	indices.resize(offset);
+	for (size_t i = 0; i < bounded.size(); ++i)
+		forEachCell(i, [&](size_t cell) { indices[cells[cell].x + cells[cell].y++] = bounded[i]; });
+}
+
+void ColliderSet::upload(GLuint& buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size)
+{
+	// Buffers are never empty, so they can always be bound
+	if (size > capacity || buffer == GL_NONE)
+	{
+		glDeleteBuffers(1, &buffer);
+		capacity = glm::max(size, (GLsizeiptr)sizeof(Collider));
+		glCreateBuffers(1, &buffer);
+		glNamedBufferData(buffer, capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	if (size > 0)
+		glNamedBufferSubData(buffer, 0, size, data);
+}
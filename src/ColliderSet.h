@@ -0,0 +1,98 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <vector>
+
+class Shader;
+
+/*
+* Runtime list of typed collision primitives hair particles are kept out of, stored in shader storage buffers.
+* Every primitive is defined in its own space under a world transform: plane is the y = 0 half-space facing +y,
+* capsule is a segment along y axis, box is centered at origin and ellipsoid is a sphere under a non-uniform scale.
+* Colliders except planes are sorted into a coarse uniform grid over their bounds on CPU whenever they change,
+* so every particle only tests colliders whose bounds overlap the cells of its path during the step and per-particle
+* cost doesn't grow with collider count. Planes are unbounded and tested by every particle.
+* Every update also uploads the transforms of the previous update, so particles are swept through the motion of the
+* collider during the step and take its velocity on contact.
+*/
+class ColliderSet {
+public:
+	enum class Type : uint32_t {
+		PLANE,
+		SPHERE,
+		CAPSULE,
+		BOX,
+		ELLIPSOID
+	};
+
+	// std430 layout of Collider in HairComputeShader
+	struct Collider {
+		glm::mat4 transform;
+		glm::mat4 inverseTransform;
+		glm::mat4 previousTransform;		// Set by update to the transform of the previous update
+		glm::mat4 previousInverseTransform;
+		glm::vec4 shape;		// Sphere and ellipsoid radius, capsule half height and radius, or box half extents
+		Type type;
+		uint32_t padding[3];
+	};
+
+	static Collider makePlane(const glm::vec3& point, const glm::vec3& normal);
+	static Collider makeSphere(const glm::vec3& center, float radius);
+	static Collider makeCapsule(const glm::vec3& start, const glm::vec3& end, float radius);
+	static Collider makeBox(const glm::mat4& transform, const glm::vec3& halfExtents);
+	static Collider makeEllipsoid(const glm::mat4& transform, float radius);
+
+	ColliderSet();
+	~ColliderSet();
+	ColliderSet(const ColliderSet&) = delete;
+	ColliderSet& operator=(const ColliderSet&) = delete;
+
+	// Returns index of the added collider, indices of other colliders never change
+	uint32_t add(const Collider& collider);
+	void set(uint32_t index, const Collider& collider);
+	const Collider& get(uint32_t index) const { return colliders[index]; }
+
+	// Disabled colliders keep their index but aren't tested by any particle
+	void setEnabled(uint32_t index, bool enabled);
+	bool isEnabled(uint32_t index) const { return enabled[index] != 0; }
+	uint32_t getCount() const { return (uint32_t)colliders.size(); }
+
+	// Bounds of colliders are extended by the margin in the grid, it has to cover particle offsets from surfaces
+	void setMargin(float distance);
+	float getMargin() const { return margin; }
+
+	/*
+	* Rebuilds grid and uploads buffers if any collider changed or moved since the last update, returns whether they did.
+	* Expected to be called once per simulation step, a collider moved since the last update is swept through the step.
+	*/
+	bool update();
+
+	// Next update treats every collider as placed at its current transform, so a jump to it isn't swept
+	void resetMotion();
+
+	// Binds collider buffers and sets grid uniforms of HairComputeShader
+	void bind(const Shader& shader) const;
+
+private:
+	void buildGrid(std::vector<glm::uvec2>& cells, std::vector<uint32_t>& indices);
+	void upload(GLuint& buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size);
+	std::vector<Collider> colliders;
+	std::vector<uint8_t> enabled;
+	std::vector<glm::mat4> simulatedTransforms;		// Transforms of the last update
+	float margin = 0.1f;
+	bool changed = true;
+	bool moving = false;		// Some collider moved in the last update, so it has to be uploaded again to stop
+	uint32_t planeCount = 0;
+	glm::vec3 gridMinimum{ 0.f };
+	float cellSize = 1.f;
+	glm::uvec3 gridResolution{ 0 };
+	GLuint colliderBuffer = GL_NONE;
+	GLuint cellBuffer = GL_NONE;			// Offset and count of collider indices of every cell
+	GLuint indexBuffer = GL_NONE;			// Plane indices followed by collider indices of all cells
+	GLsizeiptr colliderCapacity = 0;
+	GLsizeiptr cellCapacity = 0;
+	GLsizeiptr indexCapacity = 0;
+};
@@ -14,6 +14,13 @@ void ComputeShader::dispatch() const
 	glDispatchCompute(globalWorkGroupX, globalWorkGroupY, globalWorkGroupZ);
 }
 
+void ComputeShader::dispatchIndirect(GLuint buffer, GLintptr offset) const
+{
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffer);
+	glDispatchComputeIndirect(offset);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, GL_NONE);
+}
+
 glm::ivec3 ComputeShader::getMaxLocalWorkGroups() const
 {
 	glm::ivec3 values;
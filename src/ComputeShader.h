@@ -6,6 +6,9 @@ public:
 	ComputeShader(const std::string& shaderFile);
 	~ComputeShader() override = default;
 	void dispatch() const;
+
+	// Work group counts are read from three uints at offset of the buffer, written by an earlier dispatch
+	void dispatchIndirect(GLuint buffer, GLintptr offset = 0) const;
 	glm::ivec3 getMaxLocalWorkGroups() const;
 	glm::ivec3 getLocalWorkGroupsCount() const;
 	glm::ivec3 getMaxGlobalWorkGroups() const;
@@ -0,0 +1,123 @@
+#include "DeepOpacityMap.h"
+#include "Hair.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+DeepOpacityMap::DeepOpacityMap() :
+	opacityProgram("HairShadowVertexShader.glsl", "HairOpacityFragmentShader.glsl")
+{
+	glCreateVertexArrays(1, &emptyVao);
+	allocate();
+}
+
+DeepOpacityMap::~DeepOpacityMap()
+{
+	release();
+	glDeleteVertexArrays(1, &emptyVao);
+}
+
+void DeepOpacityMap::setSliceCount(uint32_t count)
+{
+	const uint32_t clampedCount = glm::clamp<uint32_t>((count + 3) / 4 * 4, 4U, 16U);
+	if (clampedCount == sliceCount)
+		return;
+
+	sliceCount = clampedCount;
+	allocate();
+}
+
+void DeepOpacityMap::setResolution(uint32_t size)
+{
+	const uint32_t clampedSize = glm::clamp<uint32_t>(size, 64U, 2048U);
+	if (clampedSize == resolution)
+		return;
+
+	resolution = clampedSize;
+	allocate();
+}
+
+void DeepOpacityMap::render(const Hair& hair, const glm::vec3& lightPosition)
+{
+	// Orthographic projection fitted to bounding sphere, depth range spans the sphere so slices cover only hair
+	const glm::vec3 center = hair.getTransformMatrix()[3];
+	const float radius = hair.getBoundingRadius();
+	glm::vec3 lightDirection = center - lightPosition;
+	lightDirection = glm::length(lightDirection) > 1e-4f ? glm::normalize(lightDirection) : glm::vec3(0.f, -1.f, 0.f);
+	const glm::vec3 up = glm::abs(lightDirection.y) > 0.99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+	const glm::mat4 view = glm::lookAt(center - lightDirection * 2.f * radius, center, up);
+	lightViewProjection = glm::ortho(-radius, radius, -radius, radius, radius, 3.f * radius) * view;
+
+	GLint previousFramebuffer = 0;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	const GLboolean blendEnabled = glIsEnabled(GL_BLEND);
+	const GLboolean depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, resolution, resolution);
+	const GLfloat clearOpacity[4] = { 0.f, 0.f, 0.f, 0.f };
+	for (uint32_t layer = 0; layer < sliceCount / 4; ++layer)
+		glClearBufferfv(GL_COLOR, layer, clearOpacity);
+
+	// Fragments are only counted, so neither order nor depth test matter
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	opacityProgram.use();
+	opacityProgram.setMat4("model", hair.getTransformMatrix());
+	opacityProgram.setMat4("lightViewProjection", lightViewProjection);
+	opacityProgram.setUint("particlesPerStrand", hair.getParticlesPerStrand());
+	opacityProgram.setInt("sliceCount", sliceCount);
+	glBindVertexArray(emptyVao);
+	glDrawArrays(GL_LINES, 0, hair.getStrandCount() * (hair.getParticlesPerStrand() - 1) * 2);
+	glBindVertexArray(GL_NONE);
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	if (!blendEnabled)
+		glDisable(GL_BLEND);
+	if (depthTestEnabled)
+		glEnable(GL_DEPTH_TEST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void DeepOpacityMap::bind(const Shader& shader, GLuint textureUnit) const
+{
+	glBindTextureUnit(textureUnit, opacityTexture);
+	shader.setInt("opacityMap", textureUnit);
+	shader.setMat4("lightViewProjection", lightViewProjection);
+	shader.setInt("opacitySliceCount", sliceCount);
+	shader.setFloat("shadowAbsorption", absorption);
+}
+
+void DeepOpacityMap::allocate()
+{
+	release();
+	const GLsizei layerCount = sliceCount / 4;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &opacityTexture);
+	glTextureStorage3D(opacityTexture, 1, GL_RGBA16F, resolution, resolution, layerCount);
+	glTextureParameteri(opacityTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(opacityTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(opacityTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(opacityTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// Every layer is a separate color attachment, fragment shader writes all of them at once
+	GLenum drawBuffers[4];
+	glCreateFramebuffers(1, &framebuffer);
+	for (GLsizei layer = 0; layer < layerCount; ++layer)
+	{
+		glNamedFramebufferTextureLayer(framebuffer, GL_COLOR_ATTACHMENT0 + layer, opacityTexture, 0, layer);
+		drawBuffers[layer] = GL_COLOR_ATTACHMENT0 + layer;
+	}
+	glNamedFramebufferDrawBuffers(framebuffer, layerCount, drawBuffers);
+}
+
+void DeepOpacityMap::release()
+{
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &opacityTexture);
+	framebuffer = GL_NONE;
+	opacityTexture = GL_NONE;
+}
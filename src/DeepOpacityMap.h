@@ -0,0 +1,50 @@
+#pragma once
+#include "DrawingShader.h"
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+
+class Hair;
+
+/*
+* Opacity of hair seen from the light, split into depth slices over the hair bounding sphere.
+* Every slice holds number of strand fragments in front of its far end, so a single lookup with interpolation between
+* two slices gives transmittance at any depth. Slices are packed four per layer of an RGBA16F texture array and all
+* of them are written by one additive line draw of simulated segments, without any per-strand work on CPU.
+* Light is treated as directional from its position towards hair center, so the map always covers the whole hair.
+*/
+class DeepOpacityMap {
+public:
+	DeepOpacityMap();
+	~DeepOpacityMap();
+	DeepOpacityMap(const DeepOpacityMap&) = delete;
+	DeepOpacityMap& operator=(const DeepOpacityMap&) = delete;
+
+	// Sets number of depth slices, rounded up to multiple of 4 and clamped in range [4, 16]
+	void setSliceCount(uint32_t count);
+	uint32_t getSliceCount() const { return sliceCount; }
+
+	// Sets width and height of every slice in texels, clamped in range [64, 2048]
+	void setResolution(uint32_t size);
+	uint32_t getResolution() const { return resolution; }
+
+	// Fraction of light absorbed by every strand fragment in front of shaded point
+	void setAbsorption(float value) { absorption = value; }
+	void render(const Hair& hair, const glm::vec3& lightPosition);
+
+	// Binds opacity map to texture unit and sets uniforms used for lookups in HairFragmentShader
+	void bind(const Shader& shader, GLuint textureUnit) const;
+
+private:
+	void allocate();
+	void release();
+	DrawingShader opacityProgram;
+	GLuint emptyVao = GL_NONE;
+	GLuint framebuffer = GL_NONE;
+	GLuint opacityTexture = GL_NONE;
+	glm::mat4 lightViewProjection{ 1.f };
+	uint32_t sliceCount = 8;
+	uint32_t resolution = 256;
+	float absorption = 0.15f;
+};
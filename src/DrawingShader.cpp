@@ -24,3 +24,21 @@ DrawingShader::DrawingShader(const std::string& vertexShaderFile, const std::str
 	glDeleteShader(fragmentShaderID);
 	glDeleteShader(geometryShaderID);
 }
+
+DrawingShader::DrawingShader(const std::string& vertexShaderFile, const std::string& tessellationControlShaderFile,
+	const std::string& tessellationEvaluationShaderFile, const std::string& fragmentShaderFile)
+{
+	GLuint vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint tessellationControlShaderID = glCreateShader(GL_TESS_CONTROL_SHADER);
+	GLuint tessellationEvaluationShaderID = glCreateShader(GL_TESS_EVALUATION_SHADER);
+	GLuint fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+	compileAndAttachShader(vertexShaderFile, vertexShaderID);
+	compileAndAttachShader(tessellationControlShaderFile, tessellationControlShaderID);
+	compileAndAttachShader(tessellationEvaluationShaderFile, tessellationEvaluationShaderID);
+	compileAndAttachShader(fragmentShaderFile, fragmentShaderID);
+	linkProgram();
+	glDeleteShader(vertexShaderID);
+	glDeleteShader(tessellationControlShaderID);
+	glDeleteShader(tessellationEvaluationShaderID);
+	glDeleteShader(fragmentShaderID);
+}
@@ -5,5 +5,7 @@ class DrawingShader : public Shader {
 public:
 	DrawingShader(const std::string& vertexShaderFile, const std::string& fragmentShaderFile);
 	DrawingShader(const std::string& vertexShaderFile, const std::string& geometryShaderFile, const std::string& fragmentShaderFile);
+	DrawingShader(const std::string& vertexShaderFile, const std::string& tessellationControlShaderFile,
+		const std::string& tessellationEvaluationShaderFile, const std::string& fragmentShaderFile);
 	~DrawingShader() override = default;
 };
\ No newline at end of file
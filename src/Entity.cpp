@@ -56,10 +56,12 @@ void Entity::updateColorsBasedOnMaterial(const Shader& shader, Material material
 			shader.setFloat("material.shininess", 1.f);
 			break;
 		case Material::HAIR:
+		case Material::HAIR_MARSCHNER:
 			shader.setVec3("material.ambient", 0.1f * color);
 			shader.setVec3("material.diffuse", color * 0.15f);
 			shader.setVec3("material.specular", color * 0.4f);
 			shader.setFloat("material.shininess", 300.f);
+			shader.setBool("material.marschner", material == Material::HAIR_MARSCHNER);
 			break;
 	}
 }
\ No newline at end of file
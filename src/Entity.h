@@ -23,7 +23,8 @@ public:
 		PLASTIC,
 		METAL,
 		FABRIC,
-		HAIR
+		HAIR,
+		HAIR_MARSCHNER		// Same colors as HAIR, shaded with Marschner lookup textures instead of Kajiya-Kay
 	};
 
 	void updateColorsBasedOnMaterial(const Shader& shader, Material material) const;
@@ -0,0 +1,28 @@
+#include "GpuCounter.h"
+
+GpuCounter::GpuCounter(GLenum queryTarget) : target(queryTarget)
+{
+	glGenQueries(1, &query);
+}
+
+GpuCounter::~GpuCounter()
+{
+	glDeleteQueries(1, &query);
+}
+
+void GpuCounter::begin() const
+{
+	glBeginQuery(target, query);
+}
+
+void GpuCounter::end() const
+{
+	glEndQuery(target);
+}
+
+uint64_t GpuCounter::getCount() const
+{
+	GLuint64 count = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &count);
+	return count;
+}
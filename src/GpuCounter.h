@@ -0,0 +1,24 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+
+/*
+* Counts a pipeline statistic of commands issued between begin() and end(),
+* GL_FRAGMENT_SHADER_INVOCATIONS unless another query target is given.
+*/
+class GpuCounter {
+public:
+	GpuCounter(GLenum queryTarget = GL_FRAGMENT_SHADER_INVOCATIONS);
+	~GpuCounter();
+	GpuCounter(const GpuCounter&) = delete;
+	GpuCounter& operator=(const GpuCounter&) = delete;
+	void begin() const;
+	void end() const;
+
+	// Waits for the query result
+	uint64_t getCount() const;
+
+private:
+	GLuint query = GL_NONE;
+	GLenum target;
+};
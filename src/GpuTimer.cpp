@@ -0,0 +1,28 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+{
+	glGenQueries(1, &query);
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(1, &query);
+}
+
+void GpuTimer::begin() const
+{
+	glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void GpuTimer::end() const
+{
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+double GpuTimer::getElapsedMilliseconds() const
+{
+	GLuint64 elapsedTime = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedTime);
+	return elapsedTime / 1e6;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <glad/glad.h>
+
+/*
+* Measures GPU execution time of commands issued between begin() and end()
+* using GL_TIME_ELAPSED query object.
+*/
+class GpuTimer {
+public:
+	GpuTimer();
+	~GpuTimer();
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+	void begin() const;
+	void end() const;
+
+	// Waits for the query result, returns elapsed time in milliseconds
+	double getElapsedMilliseconds() const;
+
+private:
+	GLuint query = GL_NONE;
+};
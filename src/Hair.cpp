@@ -1,22 +1,62 @@
 #include "Hair.h"
 #include <iostream>
-#include <glm/gtc/random.hpp>
 #include "glm/gtc/quaternion.hpp"
 #include "PathConfig.h"
-#include "OBJ_Loader.h"
+#include "HairCheckpoint.h"
+#include "HeadMeshCache.h"
+#include "HeadDistanceField.h"
+#include "RootGenerator.h"
+#include "Texture.h"
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <utility>
 #include <glm/gtx/string_cast.hpp>
 
-Hair::Hair(uint32_t _strandCount, float hairLength, float hairCurlRadius) : strandCount(_strandCount), hairLength(hairLength),
-				curlRadius(hairCurlRadius), computeShader("HairComputeShader.glsl")
+namespace {
+	glm::mat4 getHeadTransform()
+	{
+		const glm::vec3 headTranslation(0.f, -3.f, 0.f);
+		const glm::vec3 headScale(0.2f);
+		glm::quat headRotation = glm::angleAxis(glm::radians(180.f), glm::vec3(0.f, 1.f, 0.f));
+		headRotation = glm::rotate(headRotation, glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f));
+		return glm::scale(glm::translate(glm::mat4(1.f), headTranslation) * glm::mat4_cast(headRotation), headScale);
+	}
+}
+
+Hair::Hair(uint32_t _strandCount, float hairLength, float hairCurlRadius, uint32_t randomSeed) : strandCount(_strandCount), randomSeed(randomSeed),
+				curlRadius(hairCurlRadius), computeShader("HairComputeShader.glsl"), hairLength(hairLength)
 {
-	computeShader.use();
-	computeShader.setUint("hairData.strandCount", strandCount);
-	computeShader.setFloat("hairData.particleMass", 0.1f);
-	computeShader.setFloat("force.gravity", gravity);
-	computeShader.setVec4("force.wind", wind);
-	computeShader.setFloat("frictionCoefficient", frictionFactor);
-	computeShader.setFloat("velocityDampingCoefficient", velocityDampingCoefficient);
-	constructModel();
+	HeadMeshCache headMesh(TEXTURE_FOLDER + "FemaleHead/FemaleHead.obj", getHeadTransform());
+	constructHead(headMesh);
+	roots = placeRoots(headMesh);
+	const std::vector<StrandAttributes> attributes = generateStrandAttributes(roots);
+	computeBounds(roots, attributes);
+	std::vector<float> positions = constructStrands(roots, attributes);
+	createSimulationBuffers(positions.data(), nullptr, nullptr);
+	createStrandAttributeBuffer(attributes);
+	initializeComputeShader();
+	resetMotion();
+}
+
+Hair::Hair(const std::string& checkpointFile) : strandCount(5000U), randomSeed(1U), computeShader("HairComputeShader.glsl"), hairLength(3.f)
+{
+	HeadMeshCache headMesh(TEXTURE_FOLDER + "FemaleHead/FemaleHead.obj", getHeadTransform());
+	constructHead(headMesh);
+	if (!restoreCheckpoint(checkpointFile))
+	{
+		std::cout << "Generating hair instead of restoring checkpoint" << std::endl;
+		roots = placeRoots(headMesh);
+		const std::vector<StrandAttributes> attributes = generateStrandAttributes(roots);
+		computeBounds(roots, attributes);
+		std::vector<float> positions = constructStrands(roots, attributes);
+		createSimulationBuffers(positions.data(), nullptr, nullptr);
+		createStrandAttributeBuffer(attributes);
+	}
+
+	// Restored transform is where the hair starts, not a motion from identity
+	initializeComputeShader();
+	resetMotion();
 }
 
 Hair::~Hair()
@@ -24,9 +64,74 @@ Hair::~Hair()
 	glDeleteBuffers(1, &velocityArrayBuffer);
 	glDeleteBuffers(1, &volumeDensities);
 	glDeleteBuffers(1, &volumeVelocities);
+	glDeleteBuffers(1, &previousVolumeDensities);
+	glDeleteBuffers(1, &previousVolumeVelocities);
+	glDeleteBuffers(1, &strandAttributeBuffer);
+	glDeleteBuffers(1, &restShapeBuffer);
+	glDeleteBuffers(1, &instanceBuffer);
+	glDeleteBuffers(1, &strandRestBuffer);
+	glDeleteBuffers(1, &activeStrandBuffer);
+	glDeleteBuffers(1, &activeDispatchBuffer);
+	glDeleteBuffers(1, &activeCountReadback);
+	if (activeCountFence)
+		glDeleteSync(activeCountFence);
+	glDeleteBuffers(1, &headVbo);
+	glDeleteBuffers(1, &headEbo);
+	glDeleteVertexArrays(1, &headVao);
 }
 
-void Hair::constructModel()
+void Hair::initializeComputeShader()
+{
+	// Single instance owns the whole buffer capacity
+	computeShader.use();
+	computeShader.setUint("hairData.strandCount", strandCount);
+	computeShader.setUint("hairData.particlesPerStrand", particlesPerStrand);
+	computeShader.setUint("hairData.strandsPerInstance", maximumStrandCount);
+
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(HairInstance), nullptr, GL_DYNAMIC_DRAW);
+
+	computeShader.setUint("sleepSteps", sleepSteps);
+	computeShader.setFloat("sleepEnergy", sleepEnergy);
+	const GLuint zero = 0;
+	glGenBuffers(1, &strandRestBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, strandRestBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maximumStrandCount * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	glGenBuffers(1, &activeStrandBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, activeStrandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maximumStrandCount * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &activeDispatchBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, activeDispatchBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &activeCountReadback);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, activeCountReadback);
+	glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+}
+
+HairInstance Hair::makeInstance(const glm::mat4& model) const
+{
+	HairInstance instance{};
+	instance.model = model;
+	instance.inverseModel = glm::inverse(model);
+	instance.previousModel = instance.model;
+	instance.previousInverseModel = instance.inverseModel;
+	instance.wind = wind;
+	instance.gravity = gravity;
+	instance.frictionCoefficient = frictionFactor;
+	instance.velocityDampingCoefficient = velocityDampingCoefficient;
+	instance.curlRadius = curlRadius;
+	instance.volumeRepulsion = volumeRepulsion;
+	return instance;
+}
+
+void Hair::constructHead(const HeadMeshCache& headMesh)
 {
 	for (auto& e : ellipsoids)
 		e = std::make_unique<Sphere>(50, 30, ellipsoidsRadius);
@@ -61,200 +166,394 @@ void Hair::constructModel()
 	ellipsoids[6]->translate(glm::vec3(-0.015701f, -1.032532f, 0.122619f));
 	ellipsoids[6]->scale(glm::vec3(2.357361f, 3.127426f, 2.326767f));
 
-	const glm::vec3 headTranslation(0.f, -3.f, 0.f);
-	const glm::vec3 headScale(0.2f);
-	glm::quat headRotation = glm::angleAxis(glm::radians(180.f), glm::vec3(0.f, 1.f, 0.f));
-	headRotation = glm::rotate(headRotation, glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f));
-	glm::mat4 headTransform = glm::scale(glm::translate(glm::mat4(1.f), headTranslation) * glm::mat4_cast(headRotation), headScale);
+	for (const auto& collider : makeEllipsoidColliders(ellipsoidModel))
+		colliders.add(collider);
+
 	headColor = glm::vec3(0.85f, 0.48f, 0.2f);
+	distanceField = std::make_unique<HeadDistanceField>(headMesh, TEXTURE_FOLDER + "FemaleHead/FemaleHead.sdf");
+	if (!headMesh.isValid())
+		return;
 
-	objl::Loader loader;
-	std::vector<float> headData;
-	if (loader.LoadFile(TEXTURE_FOLDER + "FemaleHead/FemaleHead.obj"))
-	{
-		headData.reserve(loader.LoadedVertices.size() * 6 * 3); // 3 position component and 3 normal components
-		for (auto& vertex : loader.LoadedVertices)
-		{
-			glm::vec3 transformedVertex = headTransform * glm::vec4(vertex.Position.X, vertex.Position.Y, vertex.Position.Z, 1.f);
-			vertex.Position.X = transformedVertex.x;
-			vertex.Position.Y = transformedVertex.y;
-			vertex.Position.Z = transformedVertex.z;
-
-			glm::vec3 transformedNormal = glm::inverse(glm::transpose(headTransform)) * glm::vec4(vertex.Normal.X, vertex.Normal.Y, vertex.Normal.Z, 1.f);
-			vertex.Normal.X = transformedNormal.x;
-			vertex.Normal.Y = transformedNormal.y;
-			vertex.Normal.Z = transformedNormal.z;
-
-			headData.push_back(vertex.Position.X);
-			headData.push_back(vertex.Position.Y);
-			headData.push_back(vertex.Position.Z);
-			headData.push_back(vertex.Normal.X);
-			headData.push_back(vertex.Normal.Y);
-			headData.push_back(vertex.Normal.Z);
-		}
+	glCreateVertexArrays(1, &headVao);
+	glGenBuffers(1, &headVbo);
+	glGenBuffers(1, &headEbo);
+	glBindVertexArray(headVao);
+	glBindBuffer(GL_ARRAY_BUFFER, headVbo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)headMesh.getVertexCount() * HeadMeshCache::floatsPerVertex * sizeof(float), headMesh.getVertexData(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, headEbo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)headMesh.getIndexCount() * sizeof(GLuint), headMesh.getIndices(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), 0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+	glBindVertexArray(GL_NONE);
+	indexCount = headMesh.getIndexCount();
+}
+
+std::vector<ColliderSet::Collider> Hair::makeEllipsoidColliders(const glm::mat4& model) const
+{
+	std::vector<ColliderSet::Collider> ellipsoidColliders;
+	for (const auto& ellipsoid : ellipsoids)
+		ellipsoidColliders.push_back(ColliderSet::makeEllipsoid(model * ellipsoid->getTransformMatrix(), ellipsoidsRadius));
+
+	return ellipsoidColliders;
+}
 
-		glCreateVertexArrays(1, &headVao);
-		glGenBuffers(1, &headVbo);
-		glGenBuffers(1, &headEbo);
-		glBindVertexArray(headVao);
-		glBindBuffer(GL_ARRAY_BUFFER, headVbo);
-		glBufferData(GL_ARRAY_BUFFER, headData.size() * sizeof(float), headData.data(), GL_DYNAMIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, headEbo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, loader.LoadedIndices.size() * sizeof(GLuint), loader.LoadedIndices.data(), GL_DYNAMIC_DRAW);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), 0);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
-		glBindVertexArray(GL_NONE);
-		indexCount = loader.LoadedIndices.size();
+void Hair::updateEllipsoidColliders()
+{
+	if (transformMatrix != ellipsoidModel)
+	{
+		ellipsoidModel = transformMatrix;
+		const std::vector<ColliderSet::Collider> ellipsoidColliders = makeEllipsoidColliders(ellipsoidModel);
+		for (uint32_t i = 0; i < ellipsoidColliders.size(); ++i)
+			colliders.set(i, ellipsoidColliders[i]);
 	}
-	else 
+
+	for (uint32_t i = 0; i < ellipsoids.size(); ++i)
+		colliders.setEnabled(i, !getDistanceFieldCollision());
+}
+
+void Hair::resetMotion()
+{
+	simulatedModel = transformMatrix;
+	updateEllipsoidColliders();
+	colliders.resetMotion();
+}
+
+const HeadDistanceField* Hair::getDistanceField() const
+{
+	return distanceField && distanceField->isValid() ? distanceField.get() : nullptr;
+}
+
+std::vector<HairRoot> Hair::placeRoots(const HeadMeshCache& headMesh) const
+{
+	// Optional painted mask, hardcoded scalp region is used without it
+	ScalpMask mask;
+	const std::string maskFile = "FemaleHead/ScalpMask.png";
+	if (std::filesystem::exists(TEXTURE_FOLDER + maskFile))
 	{
-		std::cout << "File doesn't exist" << std::endl;
+		if (!mask.load(TEXTURE_FOLDER + maskFile))
+			std::cout << "Scalp mask '" << maskFile << "' couldn't be loaded, using default scalp region" << std::endl;
 	}
 
-	std::vector<float> data;
-	data.reserve(maximumStrandCount * particlesPerStrand * 3);
+	// Roots are generated for the whole capacity, any prefix of them covers the scalp evenly
+	RootGenerator rootGenerator(headMesh, &mask);
+	return rootGenerator.generateCached(TEXTURE_FOLDER + "FemaleHead/FemaleHead.roots", maximumStrandCount, randomSeed);
+}
+
+std::vector<StrandAttributes> Hair::generateStrandAttributes(const std::vector<HairRoot>& roots) const
+{
+	// Same seed as root placement, so attributes are reproducible too
+	std::mt19937 random(randomSeed);
+	auto uniform = [&random]() { return (random() >> 8) * (1.f / 16777216.f); };
+
+	// Strands without a root keep default attributes
+	const float segmentLength = hairLength / (particlesPerStrand - 1);
+	std::vector<StrandAttributes> attributes(maximumStrandCount, StrandAttributes{ glm::vec4(1.f), segmentLength, 1.f, particleMass, 0.f });
+	for (size_t i = 0; i < roots.size() && i < attributes.size(); ++i)
+	{
+		StrandAttributes& strand = attributes[i];
+		const float lengthScale = roots[i].lengthScale * (1.f - lengthVariation * uniform());
+		strand.segmentLength = segmentLength * lengthScale;
+		strand.curlScale = 1.f + curlVariation * (2.f * uniform() - 1.f);
+
+		// Mass per unit length is the same for all strands
+		strand.particleMass = particleMass * lengthScale;
+
+		// Darker and warmer tints on top of hair material color
+		const float brightness = 1.f - colorVariation * uniform();
+		const glm::vec3 tint = glm::mix(glm::vec3(1.f), glm::vec3(1.f, 0.8f, 0.6f), colorVariation * uniform());
+		strand.color = glm::vec4(brightness * tint, 1.f);
+	}
 
-	float segmentLength = hairLength / (particlesPerStrand - 1);
+	return attributes;
+}
 
-	computeShader.setFloat("curlRadius", curlRadius);
-	computeShader.setFloat("hairData.segmentLength", hairLength / (particlesPerStrand - 1));
-	computeShader.setUint("hairData.particlesPerStrand", particlesPerStrand);
-	computeShader.setFloat("ellipsoidRadius", ellipsoidsRadius);
-	uint32_t counter = 0;
-	for (uint32_t i = 0; i < loader.LoadedVertices.size(); i += 10)
+void Hair::computeBounds(const std::vector<HairRoot>& roots, const std::vector<StrandAttributes>& attributes)
+{
+	rootRadius = 0.f;
+	maximumStrandLength = 0.f;
+	for (size_t i = 0; i < roots.size(); ++i)
 	{
-		const auto& vertex = loader.LoadedVertices[i];
-		if ((vertex.Position.Y > -1.f && vertex.Position.Z < 0.f) || (vertex.Position.Y > -0.5f && vertex.Position.Z < 0.7f) || (vertex.Position.Y >= 0.5f && vertex.Position.Z < 1.7f))
-		{
-			++counter;
-			if (counter >= maximumStrandCount - 1) break;
-			for (uint32_t j = 0; j < particlesPerStrand; ++j)
-			{
-				glm::vec3 particle(vertex.Position.X, vertex.Position.Y, vertex.Position.Z);
-				particle += glm::normalize(particle) * (float)j * segmentLength;
-				data.push_back(particle.x);
-				data.push_back(particle.y);
-				data.push_back(particle.z);
-			}
-		}
+		rootRadius = glm::max(rootRadius, glm::length(roots[i].position));
+		maximumStrandLength = glm::max(maximumStrandLength, attributes[i].segmentLength * (particlesPerStrand - 1));
 	}
+}
+
+float Hair::getBoundingRadius() const
+{
+	// Roots follow hair transform, particles below them are in world space and never stretch
+	return rootRadius * glm::max(scaleVector.x, glm::max(scaleVector.y, scaleVector.z)) + maximumStrandLength;
+}
 
-	const int strandsOnHair = counter;
-	for (; counter < maximumStrandCount; ++counter) 
+std::vector<float> Hair::constructStrands(const std::vector<HairRoot>& roots, const std::vector<StrandAttributes>& attributes) const
+{
+	std::vector<float> data;
+	data.reserve(maximumStrandCount * particlesPerStrand * 3);
+
+	for (size_t i = 0; i < roots.size() && i < maximumStrandCount; ++i)
 	{
-		int randomNumber = glm::linearRand(0, strandsOnHair - 1) * particlesPerStrand * 3;
-		glm::vec3 firstCoords(data[randomNumber], data[randomNumber + 1], data[randomNumber + 2]);
-		randomNumber += particlesPerStrand * 3;
-		glm::vec3 secondCoords(data[randomNumber], data[randomNumber + 1], data[randomNumber + 2]);
-		glm::vec3 coordsBetween = secondCoords + (firstCoords - secondCoords) * 0.5f;
+		const HairRoot& root = roots[i];
 		for (uint32_t j = 0; j < particlesPerStrand; ++j)
 		{
-			glm::vec3 particle = coordsBetween + glm::normalize(coordsBetween) * (float)j * segmentLength;
+			glm::vec3 particle = root.position + root.normal * (float)j * attributes[i].segmentLength;
 			data.push_back(particle.x);
 			data.push_back(particle.y);
 			data.push_back(particle.z);
 		}
 	}
 
+	data.resize(maximumStrandCount * particlesPerStrand * 3, 0.f);
+	return data;
+}
+
+void Hair::createSimulationBuffers(const float* positions, const float* velocities, const float* restShape)
+{
+	const GLsizeiptr particleDataSize = (GLsizeiptr)maximumStrandCount * particlesPerStrand * 3 * sizeof(float);
 	glBindVertexArray(vao);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_DYNAMIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, particleDataSize, positions, GL_DYNAMIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(0);
 	glBindVertexArray(GL_NONE);
 	glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vbo);
-
-	// Velocities
-	data.clear();
-	data.reserve(maximumStrandCount * particlesPerStrand * 3);
-	for (uint32_t i = 0; i < maximumStrandCount * particlesPerStrand * 3; ++i)
-		data.push_back(0.f);
 
+	// Velocities start at zero if not provided
+	const float zero = 0.f;
 	glGenBuffers(1, &velocityArrayBuffer);
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, velocityArrayBuffer);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(float), data.data(), GL_DYNAMIC_DRAW);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocityArrayBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, particleDataSize, velocities, GL_DYNAMIC_DRAW);
+	if (!velocities)
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, &zero);
 
+	// Generated hair is created with identity transform, so its initial world positions are also in local space
+	glGenBuffers(1, &restShapeBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, restShapeBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, particleDataSize, restShape ? restShape : positions, GL_DYNAMIC_DRAW);
+
+	// Latest and previous voxel field, both empty until the first rebuild
+	const int emptyVoxel = 0;
 	GLsizeiptr voxelGridSize = 11 * 11 * 11 * sizeof(float); // 10x10x10 voxels, 11 vertices per dimension
-	glGenBuffers(1, &volumeDensities);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeDensities);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize, nullptr, GL_DYNAMIC_DRAW);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, volumeDensities);
+	for (GLuint* buffer : { &volumeDensities, &previousVolumeDensities })
+	{
+		glGenBuffers(1, buffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, *buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize, nullptr, GL_DYNAMIC_DRAW);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, &emptyVoxel);
+	}
 
 	voxelGridSize *= 3;	// 3-component vectors
-	glGenBuffers(1, &volumeVelocities);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeVelocities);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize, nullptr, GL_DYNAMIC_DRAW);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, volumeVelocities);
+	for (GLuint* buffer : { &volumeVelocities, &previousVolumeVelocities })
+	{
+		glGenBuffers(1, buffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, *buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize, nullptr, GL_DYNAMIC_DRAW);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, &emptyVoxel);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+}
 
+void Hair::createStrandAttributeBuffer(const std::vector<StrandAttributes>& attributes)
+{
+	glGenBuffers(1, &strandAttributeBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, strandAttributeBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, attributes.size() * sizeof(StrandAttributes), attributes.data(), GL_STATIC_DRAW);
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
 }
 
+bool Hair::restoreCheckpoint(const std::string& fileName)
+{
+	HairCheckpoint checkpoint(fileName);
+	if (!checkpoint.isValid())
+		return false;
+
+	const HairCheckpoint::Header& header = checkpoint.getHeader();
+	if (header.strandCapacity != maximumStrandCount || header.particlesPerStrand != particlesPerStrand
+		|| header.strandAttributeSize != sizeof(StrandAttributes) || header.rootSize != sizeof(HairRoot))
+	{
+		std::cout << "Checkpoint '" << fileName << "' has incompatible strand layout!" << std::endl;
+		return false;
+	}
+
+	strandCount = glm::min(header.strandCount, maximumStrandCount);
+	randomSeed = header.randomSeed;
+	hairLength = header.hairLength;
+	curlRadius = header.curlRadius;
+	strandWidth = glm::clamp(header.strandWidth, 0.f, 0.1f);
+	particleMass = header.particleMass;
+	gravity = header.gravity;
+	wind = glm::vec4(header.wind[0], header.wind[1], header.wind[2], header.wind[3]);
+	frictionFactor = header.frictionFactor;
+	velocityDampingCoefficient = header.velocityDampingCoefficient;
+	setBendingStiffness(header.bendingStiffness);
+	setShapeStiffness(header.shapeStiffness);
+
+	rotationQuat = glm::quat(header.rotation[0], header.rotation[1], header.rotation[2], header.rotation[3]);
+	scaleVector = glm::vec3(header.scale[0], header.scale[1], header.scale[2]);
+	translate(glm::vec3(header.translation[0], header.translation[1], header.translation[2]));
+
+	// Particle data goes from the mapped file straight to the buffers
+	createSimulationBuffers(checkpoint.getPositions(), checkpoint.getVelocities(), checkpoint.getRestShape());
+
+	// Roots and attributes are restored as saved, so they always match restored particles
+	const StrandAttributes* savedAttributes = reinterpret_cast<const StrandAttributes*>(checkpoint.getStrandAttributes());
+	const HairRoot* savedRoots = reinterpret_cast<const HairRoot*>(checkpoint.getRoots());
+	const std::vector<StrandAttributes> attributes(savedAttributes, savedAttributes + maximumStrandCount);
+	roots.assign(savedRoots, savedRoots + maximumStrandCount);
+	computeBounds(roots, attributes);
+	createStrandAttributeBuffer(attributes);
+	return true;
+}
+
+bool Hair::saveCheckpoint(const std::string& fileName) const
+{
+	const size_t floatCount = (size_t)maximumStrandCount * particlesPerStrand * 3;
+	std::vector<float> positions(floatCount), velocities(floatCount), restShape(floatCount);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, vbo);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, floatCount * sizeof(float), positions.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, velocityArrayBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, floatCount * sizeof(float), velocities.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, restShapeBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, floatCount * sizeof(float), restShape.data());
+	std::vector<StrandAttributes> attributes(maximumStrandCount);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, strandAttributeBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, attributes.size() * sizeof(StrandAttributes), attributes.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+
+	// Capacity may not be filled if root generation failed, missing roots are saved zeroed
+	std::vector<HairRoot> savedRoots(roots);
+	savedRoots.resize(maximumStrandCount, HairRoot{ glm::vec3(0.f), glm::vec3(0.f), 0.f });
+
+	HairCheckpoint::Header header;
+	std::memset(&header, 0, sizeof(header));
+	header.strandCount = strandCount;
+	header.strandCapacity = maximumStrandCount;
+	header.particlesPerStrand = particlesPerStrand;
+	header.randomSeed = randomSeed;
+	header.strandAttributeSize = sizeof(StrandAttributes);
+	header.rootSize = sizeof(HairRoot);
+	header.hairLength = hairLength;
+	header.curlRadius = curlRadius;
+	header.strandWidth = strandWidth;
+	header.particleMass = particleMass;
+	header.gravity = gravity;
+	for (int i = 0; i < 4; ++i)
+		header.wind[i] = wind[i];
+	header.frictionFactor = frictionFactor;
+	header.velocityDampingCoefficient = velocityDampingCoefficient;
+	header.bendingStiffness = bendingStiffness;
+	header.shapeStiffness = shapeStiffness;
+	for (int i = 0; i < 3; ++i)
+	{
+		header.translation[i] = translationVector[i];
+		header.scale[i] = scaleVector[i];
+	}
+	header.rotation[0] = rotationQuat.w;
+	header.rotation[1] = rotationQuat.x;
+	header.rotation[2] = rotationQuat.y;
+	header.rotation[3] = rotationQuat.z;
+
+	bool saved = HairCheckpoint::save(fileName, header, positions.data(), velocities.data(), restShape.data(), attributes.data(), savedRoots.data());
+	if (saved)
+		std::cout << "Checkpoint saved to '" << fileName << "'" << std::endl;
+
+	return saved;
+}
+
 void Hair::setGravity(float strength)
 {
 	gravity = strength;
-	settingsChanged = true;
 }
 
 void Hair::increaseStrandCount()
 {
 	strandCount = glm::clamp<int>(strandCount + 100, 0, maximumStrandCount);
-	settingsChanged = true;
 	std::cout << "Strand count: " << strandCount << '\n';
 }
 
 void Hair::decreaseStrandCount()
 {
 	strandCount = glm::clamp<int>(strandCount - 100, 0, maximumStrandCount);
-	settingsChanged = true;
 	std::cout << "Strand count: " << strandCount << '\n';
 }
 
+void Hair::setStrandCount(uint32_t count)
+{
+	strandCount = glm::min(count, maximumStrandCount);
+}
+
 void Hair::increaseVelocityDamping()
 {
 	velocityDampingCoefficient = glm::clamp(velocityDampingCoefficient + 0.01f, 0.f, 1.f);
-	settingsChanged = true;
 	std::cout << "Velocity damping coefficient: " << velocityDampingCoefficient << '\n';
 }
 
 void Hair::decreaseVelocityDamping()
 {
 	velocityDampingCoefficient = glm::clamp(velocityDampingCoefficient - 0.01f, 0.f, 1.f);
-	settingsChanged = true;
 	std::cout << "Velocity damping coefficient: " << velocityDampingCoefficient << '\n';
 }
 
 void Hair::increaseCurlRadius()
 {
 	curlRadius = glm::clamp(curlRadius + 0.001f, 0.f, 0.05f);
-	strandWidth = curlRadius * 50.f;
 }
 
 void Hair::decreaseCurlRadius()
 {
 	curlRadius = glm::clamp(curlRadius - 0.001f, 0.f, 0.05f);
-	strandWidth = curlRadius * 50.f;
+}
+
+void Hair::setStrandWidth(float width)
+{
+	strandWidth = glm::clamp(width, 0.f, 0.1f);
+	std::cout << "Strand width: " << strandWidth << std::endl;
 }
 
 void Hair::setWind(const glm::vec3& direction, float strength)
 {
 	wind = glm::vec4(direction.x, direction.y, direction.z, glm::clamp(strength, 0.f, 1.f));
-	settingsChanged = true;
+}
+
+void Hair::setVolumeUpdateInterval(uint32_t steps)
+{
+	volumeUpdateInterval = glm::max(steps, 1U);
+	volumeStep = 0;
 }
 
 void Hair::setFrictionFactor(float friction)
 {
 	frictionFactor = glm::clamp<float>(friction, 0.f, 1.f);
-	settingsChanged = true;
 	std::cout << "Friction factor: " << frictionFactor << std::endl;
 }
 
+void Hair::setVolumeRepulsion(float strength)
+{
+	volumeRepulsion = glm::clamp(strength, 0.f, 10.f);
+	std::cout << "Volume repulsion: " << volumeRepulsion << std::endl;
+}
+
+void Hair::setSolverIterations(uint32_t iterations)
+{
+	solverIterations = glm::clamp(iterations, 1U, 64U);
+}
+
+void Hair::bindSolver(const Shader& shader) const
+{
+	shader.setUint("solver", (uint32_t)solver);
+	shader.setUint("solverIterations", solverIterations);
+	shader.setFloat("stretchCompliance", stretchCompliance);
+	shader.setFloat("bendingCompliance", bendingCompliance);
+	shader.setFloat("bendingStiffness", bendingStiffness);
+	shader.setFloat("shapeStiffness", shapeStiffness);
+}
+
 void Hair::draw() const
 {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, strandAttributeBuffer);
 	glBindVertexArray(vao);
 	for (uint32_t i = 0; i < strandCount; ++i)
 	{
@@ -263,6 +562,65 @@ void Hair::draw() const
 	glBindVertexArray(GL_NONE);
 }
 
+void Hair::drawIndirect(GLuint commandBuffer, GLuint countBuffer) const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, strandAttributeBuffer);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBindBuffer(GL_PARAMETER_BUFFER, countBuffer);
+	glMultiDrawArraysIndirectCount(GL_LINE_STRIP, nullptr, 0, strandCount, 0);
+	glBindBuffer(GL_PARAMETER_BUFFER, GL_NONE);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GL_NONE);
+	glBindVertexArray(GL_NONE);
+}
+
+void Hair::readParticleState(std::vector<float>& positions, std::vector<float>& velocities) const
+{
+	const size_t floatCount = (size_t)strandCount * particlesPerStrand * 3;
+	positions.resize(floatCount);
+	velocities.resize(floatCount);
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, vbo);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, floatCount * sizeof(float), positions.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, velocityArrayBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, floatCount * sizeof(float), velocities.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+}
+
+void Hair::captureRestShape()
+{
+	const size_t particleCount = (size_t)maximumStrandCount * particlesPerStrand;
+	std::vector<float> restShape(particleCount * 3);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glGetNamedBufferSubData(vbo, 0, restShape.size() * sizeof(float), restShape.data());
+
+	// Roots are already in local space, other particles are simulated in world space
+	const glm::mat4 inverseModel = glm::inverse(transformMatrix);
+	for (size_t particle = 0; particle < particleCount; ++particle)
+	{
+		if (particle % particlesPerStrand == 0)
+			continue;
+
+		float* position = &restShape[particle * 3];
+		const glm::vec3 localPosition(inverseModel * glm::vec4(position[0], position[1], position[2], 1.f));
+		position[0] = localPosition.x;
+		position[1] = localPosition.y;
+		position[2] = localPosition.z;
+	}
+
+	glNamedBufferSubData(restShapeBuffer, 0, restShape.size() * sizeof(float), restShape.data());
+	std::cout << "Hair rest shape captured" << std::endl;
+}
+
+void Hair::uploadPositions(const std::vector<float>& positions)
+{
+	const size_t floatCount = glm::min(positions.size(), (size_t)maximumStrandCount * particlesPerStrand * 3);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, floatCount * sizeof(float), positions.data());
+	glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+}
+
 void Hair::drawHead() const
 {
 	glBindVertexArray(headVao);
@@ -272,45 +630,51 @@ void Hair::drawHead() const
 
 void Hair::applyPhysics(float deltaTime, float runningTime)
 { 
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeDensities);
-	int* densities = (int*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_WRITE_ONLY);
-	uint32_t volumeSize = 11 * 11 * 11;
-	for (uint32_t i = 0; i < volumeSize; ++i)
+	// Latest field becomes the previous one and is rebuilt into the other buffers
+	const bool rebuildVolumes = volumeStep == 0;
+	if (rebuildVolumes)
 	{
-		densities[i] = 0;
+		const int zero = 0;
+		std::swap(volumeDensities, previousVolumeDensities);
+		std::swap(volumeVelocities, previousVolumeVelocities);
+		glClearNamedBufferData(volumeDensities, GL_R32I, GL_RED_INTEGER, GL_INT, &zero);
+		glClearNamedBufferData(volumeVelocities, GL_R32I, GL_RED_INTEGER, GL_INT, &zero);
 	}
-	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
 
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeVelocities);
-	int* velocities = (int*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_WRITE_ONLY);
+	const float volumeBlend = (float)(volumeStep + 1) / volumeUpdateInterval;
+	volumeStep = (volumeStep + 1) % volumeUpdateInterval;
 
-	for (uint32_t i = 0; i < volumeSize * 3; i++)
-	{
-		velocities[i] = 0;	
-	}
-	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+	// Parameters and transform may change between any two steps
+	HairInstance instance = makeInstance(transformMatrix);
+	instance.previousModel = simulatedModel;
+	instance.previousInverseModel = glm::inverse(simulatedModel);
+	simulatedModel = transformMatrix;
+	glNamedBufferSubData(instanceBuffer, 0, sizeof(HairInstance), &instance);
+	updateEllipsoidColliders();
+	const bool collidersChanged = colliders.update();
 
-	computeShader.use();
-	if (settingsChanged)
-	{
-		computeShader.setFloat("force.gravity", gravity);
-		computeShader.setVec4("force.wind", wind);
-		computeShader.setFloat("frictionCoefficient", frictionFactor);
-		computeShader.setFloat("velocityDampingCoefficient", velocityDampingCoefficient);
-		settingsChanged = false;
-	}
-
-	for (uint32_t i = 0; i < ellipsoids.size(); ++i)
-	{
-		computeShader.setMat4("ellipsoids[" + std::to_string(i) + "]", transformMatrix * ellipsoids[i]->getTransformMatrix());
-	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vbo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocityArrayBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, volumeDensities);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, volumeVelocities);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, strandAttributeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, previousVolumeDensities);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, previousVolumeVelocities);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 18, restShapeBuffer);
 
-	computeShader.setMat4("model", transformMatrix);
+	computeShader.use();
 	computeShader.setUint("hairData.strandCount", strandCount);
+	computeShader.setFloat("volumeBlend", volumeBlend);
 	computeShader.setFloat("deltaTime", deltaTime);
 	computeShader.setFloat("runningTime", runningTime);
-	computeShader.setUint("state", 0);
+	computeShader.setBool("sleeping", sleeping);
+	computeShader.setBool("distanceFieldCollision", getDistanceFieldCollision());
+	bindSolver(computeShader);
+	if (getDistanceFieldCollision())
+		distanceField->bind(computeShader, 0);
+
+	colliders.bind(computeShader);
 	GLuint localWorkGroupCountX = computeShader.getLocalWorkGroupsCount().x;
 	GLuint globalWorkGroupCount = strandCount / localWorkGroupCountX;
 	if (strandCount % localWorkGroupCountX != 0)
@@ -319,7 +683,20 @@ void Hair::applyPhysics(float deltaTime, float runningTime)
 	}
 
 	computeShader.setGlobalWorkGroupCount(globalWorkGroupCount);
-	computeShader.dispatch();
+	if (sleeping)
+	{
+		buildActiveStrandList(instance, collidersChanged);
+		computeShader.setUint("state", 0);
+		computeShader.dispatchIndirect(activeDispatchBuffer);
+		readActiveStrandCount();
+	}
+	else
+	{
+		strandsAwake = false;
+		computeShader.setUint("state", 0);
+		computeShader.dispatch();
+	}
+
 	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
 	globalWorkGroupCount = strandCount * particlesPerStrand / localWorkGroupCountX;
@@ -328,10 +705,51 @@ void Hair::applyPhysics(float deltaTime, float runningTime)
 		globalWorkGroupCount += 1;
 	}
 	computeShader.setGlobalWorkGroupCount(globalWorkGroupCount);
-	computeShader.setUint("state", 1);
-	computeShader.dispatch();
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	if (rebuildVolumes)
+	{
+		computeShader.setUint("state", 1);
+		computeShader.dispatch();
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
 
 	computeShader.setUint("state", 2);
 	computeShader.dispatch();
-}
\ No newline at end of file
+}
+
+void Hair::buildActiveStrandList(const HairInstance& instance, bool collidersChanged)
+{
+	/*
+	* Strands are woken by moving head, colliders or any force change, and all at once when sleeping is enabled.
+	* Dynamic wind changes with running time without changing the instance, so it keeps them awake.
+	*/
+	const bool dynamicWind = glm::vec3(instance.wind) == glm::vec3(0.f) && instance.wind.w > 0.f;
+	const bool wake = !strandsAwake || collidersChanged || dynamicWind || std::memcmp(&instance, &simulatedInstance, sizeof(HairInstance)) != 0;
+	simulatedInstance = instance;
+	strandsAwake = true;
+
+	const GLuint emptyDispatch[4] = { 0, 1, 1, 0 };
+	glNamedBufferSubData(activeDispatchBuffer, 0, sizeof(emptyDispatch), emptyDispatch);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, strandRestBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, activeStrandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, activeDispatchBuffer);
+	computeShader.setBool("wakeStrands", wake);
+	computeShader.setUint("state", 3);
+	computeShader.dispatch();
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void Hair::readActiveStrandCount()
+{
+	// Only one copy is in flight, count is updated once the GPU has finished it
+	if (activeCountFence)
+	{
+		if (glClientWaitSync(activeCountFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			return;
+
+		glDeleteSync(activeCountFence);
+		glGetNamedBufferSubData(activeCountReadback, 0, sizeof(GLuint), &activeStrandCount);
+	}
+
+	glCopyNamedBufferSubData(activeDispatchBuffer, activeCountReadback, 3 * sizeof(GLuint), 0, sizeof(GLuint));
+	activeCountFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
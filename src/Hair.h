@@ -1,28 +1,141 @@
 #pragma once
 #include "Entity.h"
 #include "ComputeShader.h"
+#include "ColliderSet.h"
+#include "RootGenerator.h"
+#include <glm/common.hpp>
 #include <memory>
 #include <vector>
 #include <array>
+#include <string>
 #include "Sphere.h"
 #include "Window.h"
 
+class HeadMeshCache;
+class HeadDistanceField;
+
+/*
+* Per-strand attributes generated at root placement, std430 layout of StrandAttributes buffer in shaders.
+* Curl scale multiplies global curl radius, so curl can still be changed interactively.
+*/
+struct StrandAttributes {
+	glm::vec4 color;
+	float segmentLength;
+	float curlScale;
+	float particleMass;
+	float stiffness;
+};
+
+/*
+* Transform and forces of one simulated hair, std430 layout of HairInstance buffer in shaders.
+* Inverse transform is precomputed, so simulation doesn't invert matrices per particle.
+* Previous transform is the one of the previous simulation step, head collision is swept through the motion between them.
+*/
+struct HairInstance {
+	glm::mat4 model;
+	glm::mat4 inverseModel;
+	glm::mat4 previousModel;
+	glm::mat4 previousInverseModel;
+	glm::vec4 wind;
+	float gravity;
+	float frictionCoefficient;
+	float velocityDampingCoefficient;
+	float curlRadius;
+	float volumeRepulsion;
+	float padding[3];
+};
+
 class Hair : public Entity {
 public:
-	Hair(uint32_t _strandCount = 5000U, float hairLength = 3.f, float hairCurliness = 0.0f);
+	/*
+	* Follow-the-leader is a single pass over every strand and the fast default. XPBD solves stretch and bending
+	* constraints with a configurable number of iterations, which costs more but keeps its accuracy at any time step.
+	*/
+	enum class Solver : uint32_t {
+		FOLLOW_THE_LEADER,
+		XPBD
+	};
+
+	/*
+	* Random seed is used for blue-noise root placement on the scalp.
+	* Same seed always produces the same initial hair state.
+	*/
+	Hair(uint32_t _strandCount = 5000U, float hairLength = 3.f, float hairCurliness = 0.0f, uint32_t randomSeed = 1U);
+
+	/*
+	* Restores positions, velocities, roots, per-strand attributes and parameters saved with saveCheckpoint, nothing is generated again.
+	* Falls back to default generated hair if file can't be restored.
+	*/
+	Hair(const std::string& checkpointFile);
 	~Hair();
+	bool saveCheckpoint(const std::string& fileName) const;
 	void draw() const override;
+
+	// Draws line strip commands of visible strands, with their count read from the count buffer, see HairCuller
+	void drawIndirect(GLuint commandBuffer, GLuint countBuffer) const;
 	void drawHead() const;
 	void applyPhysics(float deltaTime, float runningTime);
 	void setGravity(float strength);
 	void increaseStrandCount();
 	void decreaseStrandCount();
+
+	// Sets strand count clamped in range [0, maximumStrandCount]
+	void setStrandCount(uint32_t count);
 	void increaseVelocityDamping();
 	void decreaseVelocityDamping();
 	float getCurlRadius() const { return curlRadius; }
+	float getStrandWidth() const { return strandWidth; }
 	float getFrictionFactor() const { return frictionFactor; }
 	uint32_t getParticlesPerStrand() const { return particlesPerStrand; }
+	uint32_t getStrandCount() const { return strandCount; }
+	uint32_t getMaximumStrandCount() const { return maximumStrandCount; }
+
+	// Radius of a sphere around hair origin that contains every strand in any pose
+	float getBoundingRadius() const;
 	const std::array<std::unique_ptr<Sphere>, 7>& getEllipsoids() const { return ellipsoids; }
+
+	/*
+	* Head collision uses signed distance field baked from the head mesh, or 7 ellipsoid colliders approximating it when disabled.
+	* Ellipsoids are always used if the head mesh couldn't be loaded.
+	*/
+	void setDistanceFieldCollision(bool enabled) { distanceFieldCollision = enabled; }
+	bool getDistanceFieldCollision() const { return distanceFieldCollision && getDistanceField() != nullptr; }
+
+	// Baked distance field of the head, nullptr without head mesh
+	const HeadDistanceField* getDistanceField() const;
+
+	/*
+	* Colliders tested by every particle in world space, e.g. shoulders, hands or props.
+	* First 7 of them are the head ellipsoids, which follow hair transform and are disabled with distance field collision.
+	*/
+	ColliderSet& getColliders() { return colliders; }
+
+	/*
+	* Next step treats hair and its colliders as already placed at their current transforms instead of sweeping
+	* particles through the jump from the previous ones. Called after construction, and after any teleport.
+	*/
+	void resetMotion();
+
+	// Head ellipsoids as colliders of this hair placed with the given transform
+	std::vector<ColliderSet::Collider> makeEllipsoidColliders(const glm::mat4& model) const;
+
+	// Simulation parameters of this hair placed with the given transform
+	HairInstance makeInstance(const glm::mat4& model) const;
+
+	// Reads back positions and velocities of the first strandCount strands, 3 floats per particle
+	void readParticleState(std::vector<float>& positions, std::vector<float>& velocities) const;
+
+	// Overwrites positions of the first positions.size() / (3 * particlesPerStrand) strands, used for playback without simulation
+	void uploadPositions(const std::vector<float>& positions);
+	GLuint getPositionBuffer() const { return vbo; }
+	GLuint getStrandAttributeBuffer() const { return strandAttributeBuffer; }
+
+	/*
+	* Styled pose strands return to, 3 floats per particle in hair local space. It is the initial pose of generated hair,
+	* or the one saved with a checkpoint, and captureRestShape replaces it with the current pose.
+	*/
+	GLuint getRestShapeBuffer() const { return restShapeBuffer; }
+	void captureRestShape();
 	
 	// Increases curl radius by 0.01 clamped in range [0, 0.05]
 	void increaseCurlRadius();
@@ -30,6 +143,9 @@ public:
 	// Decreases curl radius by 0.01 clamped in range [0, 0.05]
 	void decreaseCurlRadius();
 
+	// Sets world space width of ribbon strands clamped in range [0, 0.1]
+	void setStrandWidth(float width);
+
 	/*
 	* Sets wind direction and strength. 
 	* If direction set to { 0.f, 0.f, 0.f } wind is dynamic with specified strength
@@ -40,24 +156,124 @@ public:
 	// Sets friction factor clamped in range [0, 1] 
 	void setFrictionFactor(float friction);
 
+	/*
+	* Strength of strand-strand repulsion computed from the gradient of the voxel density field used for friction,
+	* which keeps hair from collapsing into a thin layer. Clamped in range [0, 10], 0 disables it.
+	*/
+	void setVolumeRepulsion(float strength);
+	float getVolumeRepulsion() const { return volumeRepulsion; }
+
+	void setSolver(Solver type) { solver = type; }
+	Solver getSolver() const { return solver; }
+
+	// Constraint iterations of XPBD solver per step, clamped in range [1, 64]
+	void setSolverIterations(uint32_t iterations);
+	uint32_t getSolverIterations() const { return solverIterations; }
+
+	/*
+	* Compliance of XPBD constraints, the inverse of their stiffness, 0 makes them rigid.
+	* Bending compliance of every strand is further scaled by 1 - its stiffness.
+	*/
+	void setStretchCompliance(float compliance) { stretchCompliance = glm::max(compliance, 0.f); }
+	void setBendingCompliance(float compliance) { bendingCompliance = glm::max(compliance, 0.f); }
+	float getStretchCompliance() const { return stretchCompliance; }
+	float getBendingCompliance() const { return bendingCompliance; }
+
+	/*
+	* Bending stiffness in range [0, 1] keeps every segment at its rest angle to the previous segment, which holds
+	* curls and styles without raising damping. It is added to stiffness of every strand. Shape stiffness in range
+	* [0, 1] pulls particles towards their rest positions on the head, firmly holding the whole style.
+	* Both are position corrections within the solver pass, so they stay stable at large time steps.
+	*/
+	void setBendingStiffness(float stiffness) { bendingStiffness = glm::clamp(stiffness, 0.f, 1.f); }
+	void setShapeStiffness(float stiffness) { shapeStiffness = glm::clamp(stiffness, 0.f, 1.f); }
+	float getBendingStiffness() const { return bendingStiffness; }
+	float getShapeStiffness() const { return shapeStiffness; }
+
+	// Sets solver and rest shape uniforms of HairComputeShader
+	void bindSolver(const Shader& shader) const;
+
+	/*
+	* Strands that stay nearly still for a number of steps fall asleep and are skipped by simulation until head
+	* transform or any force parameter changes. Awake strands are compacted into a list on GPU every step,
+	* which sizes the indirect dispatch of FTL stage.
+	*/
+	void setSleeping(bool enabled) { sleeping = enabled; }
+	bool getSleeping() const { return sleeping; }
+
+	// Awake strands of a recently finished step, read back without waiting for GPU
+	uint32_t getActiveStrandCount() const { return sleeping ? activeStrandCount : strandCount; }
+
+	/*
+	* Voxel velocity field used for hair friction is rebuilt only every given step, at least 1.
+	* Friction still runs every step with the field blended from the last two rebuilds.
+	*/
+	void setVolumeUpdateInterval(uint32_t steps);
+	uint32_t getVolumeUpdateInterval() const { return volumeUpdateInterval; }
+
 private:
 	GLuint velocityArrayBuffer = GL_NONE;		// Shader storage buffer object for velocities
 	GLuint volumeDensities = GL_NONE;
 	GLuint volumeVelocities = GL_NONE;
+	GLuint previousVolumeDensities = GL_NONE;
+	GLuint previousVolumeVelocities = GL_NONE;
+	GLuint strandAttributeBuffer = GL_NONE;
+	GLuint restShapeBuffer = GL_NONE;
+	GLuint instanceBuffer = GL_NONE;
+	GLuint strandRestBuffer = GL_NONE;
+	GLuint activeStrandBuffer = GL_NONE;
+	GLuint activeDispatchBuffer = GL_NONE;		// Indirect dispatch group counts and active strand count
+	GLuint activeCountReadback = GL_NONE;
+	GLsync activeCountFence = nullptr;
 
 	uint32_t strandCount;
+	uint32_t randomSeed;
 	float curlRadius = 0.0f;
 	ComputeShader computeShader;
 	uint32_t particlesPerStrand = 15;
 	glm::vec4 wind{ 0.f, 0.f, 0.f, 0.2f };
 	float gravity = -9.81f;
-	bool settingsChanged = false;
 	const uint32_t maximumStrandCount = 30000U;
 	float frictionFactor = 0.02f;
-	void constructModel();
-	float strandWidth = 0.2f;
+	float volumeRepulsion = 0.f;
+	Solver solver = Solver::FOLLOW_THE_LEADER;
+	uint32_t solverIterations = 4;
+	float stretchCompliance = 0.f;
+	float bendingCompliance = 1e-3f;
+	float bendingStiffness = 0.f;
+	float shapeStiffness = 0.f;
+	float strandWidth = 0.01f;
 	float hairLength = 1.f;
+	float particleMass = 0.1f;
 	float velocityDampingCoefficient = 0.9f;
+	bool sleeping = false;
+	bool strandsAwake = false;			// All strands were woken since sleeping was enabled
+	uint32_t sleepSteps = 30;
+	float sleepEnergy = 5e-6f;
+	uint32_t activeStrandCount = 0;
+	HairInstance simulatedInstance{};		// Instance of the previous step, any change wakes all strands
+	uint32_t volumeUpdateInterval = 1;
+	uint32_t volumeStep = 0;				// Steps since the last voxel field rebuild
+
+	// Relative random variation of per-strand attributes
+	float lengthVariation = 0.1f;
+	float curlVariation = 0.4f;
+	float colorVariation = 0.15f;
+	float rootRadius = 0.f;				// Furthest root from origin in local space
+	float maximumStrandLength = 0.f;
+	std::vector<HairRoot> roots;		// Placed for the whole strand capacity, saved with checkpoints
+	void constructHead(const HeadMeshCache& headMesh);
+	std::vector<HairRoot> placeRoots(const HeadMeshCache& headMesh) const;
+	std::vector<StrandAttributes> generateStrandAttributes(const std::vector<HairRoot>& roots) const;
+	void computeBounds(const std::vector<HairRoot>& roots, const std::vector<StrandAttributes>& attributes);
+	std::vector<float> constructStrands(const std::vector<HairRoot>& roots, const std::vector<StrandAttributes>& attributes) const;
+	// Rest shape is taken from positions if not provided
+	void createSimulationBuffers(const float* positions, const float* velocities, const float* restShape);
+	void createStrandAttributeBuffer(const std::vector<StrandAttributes>& attributes);
+	bool restoreCheckpoint(const std::string& fileName);
+	void initializeComputeShader();
+	void buildActiveStrandList(const HairInstance& instance, bool collidersChanged);
+	void readActiveStrandCount();
 
 	// Head variables
 	glm::vec3 headColor;
@@ -67,4 +283,10 @@ private:
 	uint32_t indexCount = 0;
 	std::array<std::unique_ptr<Sphere>, 7> ellipsoids;
 	float ellipsoidsRadius = 0.5f;
+	std::unique_ptr<HeadDistanceField> distanceField;
+	bool distanceFieldCollision = true;
+	ColliderSet colliders;
+	glm::mat4 ellipsoidModel{ 1.f };		// Transform head ellipsoid colliders were placed with
+	glm::mat4 simulatedModel{ 1.f };		// Transform of the last simulation step
+	void updateEllipsoidColliders();
 };
\ No newline at end of file
@@ -0,0 +1,491 @@
+#include "Window.h"
+#include "Camera.h"
+#include "Hair.h"
+#include "HairRenderer.h"
+#include "HairSystem.h"
+#include "GpuCounter.h"
+#include "GpuTimer.h"
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+template<typename T> using Unique = std::unique_ptr<T>;
+
+namespace {
+	// Simulation always advances by the same step, so every run of a scenario is identical
+	constexpr float timeStep = 1.f / 60.f;
+
+	struct Settings {
+		uint32_t frames = 600;
+		uint32_t warmupFrames = 60;
+		uint32_t seed = 1;
+		std::string scenarioFilter;
+		std::string csvFile;
+	};
+
+	struct Statistics {
+		double mean = 0.0;
+		double minimum = 0.0;
+		double maximum = 0.0;
+		double median = 0.0;
+		double percentile95 = 0.0;
+		double standardDeviation = 0.0;
+	};
+
+	struct Scenario {
+		std::string name;
+		uint32_t strandCount;
+
+		// Called before every frame with frame index and simulation running time
+		std::function<void(Hair&, uint32_t, float)> update;
+		HairRenderer::Mode renderMode = HairRenderer::Mode::GEOMETRY_SHADER;
+		float curlRadius = 0.f;
+		float transparencyScale = 0.f;		// Resolution scale of order-independent transparency buffers, 0 draws opaque hair
+		bool depthPrepass = false;
+		uint32_t instanceCount = 0;			// Heads of a hair system with strandCount strands each, 0 simulates a single hair
+		bool culling = false;				// Frustum culling, culled crowd instances are simulated every 4th step
+	};
+
+	struct ScenarioResult {
+		std::string name;
+		uint32_t strandCount;
+		Statistics simulation;		// GPU time spent in Hair::applyPhysics
+		Statistics drawing;			// GPU time spent in HairRenderer::draw
+		Statistics frame;			// CPU time of the whole frame, including waiting for GPU
+		Statistics fragments;		// Hair fragment shader invocations of the shading pass in millions
+		Statistics activeStrands;	// Strands simulated by FTL stage, lower than strand count only with sleeping
+		std::vector<float> positions;	// Particle positions after the last frame, single hair only
+		double positionError = -1.0;	// RMS distance of final positions from reference scenario, negative if not compared
+	};
+
+	Statistics computeStatistics(std::vector<double> samples)
+	{
+		Statistics statistics;
+		if (samples.empty())
+			return statistics;
+
+		std::sort(samples.begin(), samples.end());
+		statistics.minimum = samples.front();
+		statistics.maximum = samples.back();
+		statistics.median = samples[samples.size() / 2];
+		size_t percentileIndex = (size_t)std::ceil(samples.size() * 0.95) - 1;
+		statistics.percentile95 = samples[std::min(percentileIndex, samples.size() - 1)];
+		statistics.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+
+		double variance = 0.0;
+		for (double sample : samples)
+			variance += (sample - statistics.mean) * (sample - statistics.mean);
+		statistics.standardDeviation = std::sqrt(variance / samples.size());
+
+		return statistics;
+	}
+
+	std::vector<Scenario> createScenarios()
+	{
+		std::vector<Scenario> scenarios;
+
+		scenarios.push_back({ "idle-hang", 2000, [](Hair& hair, uint32_t frame, float) {
+			if (frame == 0)
+				hair.setWind(glm::vec3(0.f), 0.f);
+		}});
+
+		// Hanging hair falls asleep strand by strand, compare simulation time with idle-hang
+		scenarios.push_back({ "idle-hang-sleep", 2000, [](Hair& hair, uint32_t frame, float) {
+			if (frame == 0)
+			{
+				hair.setWind(glm::vec3(0.f), 0.f);
+				hair.setSleeping(true);
+			}
+		}});
+
+		// Same as idle-hang with density gradient repulsion, the difference is the cost of volume preservation
+		scenarios.push_back({ "idle-hang-repulsion", 2000, [](Hair& hair, uint32_t frame, float) {
+			if (frame == 0)
+			{
+				hair.setWind(glm::vec3(0.f), 0.f);
+				hair.setVolumeRepulsion(1.f);
+			}
+		}});
+
+		scenarios.push_back({ "constant-wind", 2000, [](Hair& hair, uint32_t frame, float) {
+			if (frame == 0)
+				hair.setWind(glm::vec3(1.f, 0.f, 0.3f), 0.5f);
+		}});
+
+		scenarios.push_back({ "dynamic-wind", 2000, [](Hair& hair, uint32_t frame, float) {
+			if (frame == 0)
+				hair.setWind(glm::vec3(0.f), 0.5f);
+		}});
+
+		// Head swings +-60 degrees around y axis with period of 4 seconds
+		scenarios.push_back({ "head-rotation-sweep", 2000, [previousAngle = 0.f](Hair& hair, uint32_t frame, float runningTime) mutable {
+			if (frame == 0)
+				hair.setWind(glm::vec3(0.f), 0.f);
+
+			float angle = 60.f * glm::sin(glm::two_pi<float>() * runningTime / 4.f);
+			hair.rotate(angle - previousAngle, glm::vec3(0.f, 1.f, 0.f));
+			previousAngle = angle;
+		}});
+
+		// Same sweep colliding with the 7 ellipsoids instead of head distance field
+		scenarios.push_back({ "head-rotation-ellipsoids", 2000, [previousAngle = 0.f](Hair& hair, uint32_t frame, float runningTime) mutable {
+			if (frame == 0)
+			{
+				hair.setWind(glm::vec3(0.f), 0.f);
+				hair.setDistanceFieldCollision(false);
+			}
+
+			float angle = 60.f * glm::sin(glm::two_pi<float>() * runningTime / 4.f);
+			hair.rotate(angle - previousAngle, glm::vec3(0.f, 1.f, 0.f));
+			previousAngle = angle;
+		}});
+
+		for (uint32_t strandCount : { 1000U, 2000U, 5000U, 10000U, 20000U, 30000U })
+		{
+			scenarios.push_back({ "strands-" + std::to_string(strandCount), strandCount, [](Hair& hair, uint32_t frame, float) {
+				if (frame == 0)
+					hair.setWind(glm::vec3(0.f), 0.5f);
+			}});
+		}
+
+		// Same curled hair drawn with every curl expansion path
+		for (HairRenderer::Mode mode : { HairRenderer::Mode::GEOMETRY_SHADER, HairRenderer::Mode::TESSELLATION, HairRenderer::Mode::COMPUTE, HairRenderer::Mode::RIBBONS })
+		{
+			std::string name = std::string("render-") + HairRenderer::getModeName(mode);
+			std::replace(name.begin(), name.end(), ' ', '-');
+			scenarios.push_back({ name, 10000, [](Hair& hair, uint32_t frame, float) {
+				if (frame == 0)
+					hair.setWind(glm::vec3(0.f), 0.5f);
+			}, mode, 0.02f });
+		}
+
+		// Same opaque hair shaded with and without depth prepass, compare fragment shader invocations
+		for (bool depthPrepass : { false, true })
+		{
+			scenarios.push_back({ depthPrepass ? "depth-prepass-on" : "depth-prepass-off", 10000, [](Hair& hair, uint32_t frame, float) {
+				if (frame == 0)
+					hair.setWind(glm::vec3(0.f), 0.5f);
+			}, HairRenderer::Mode::GEOMETRY_SHADER, 0.02f, 0.f, depthPrepass });
+		}
+
+		// Order-independent transparent ribbons at full and half buffer resolution, compared against opaque render-ribbons
+		for (float scale : { 1.f, 0.5f })
+		{
+			scenarios.push_back({ "render-ribbons-oit-" + std::to_string((int)(scale * 100)), 10000, [](Hair& hair, uint32_t frame, float) {
+				if (frame == 0)
+					hair.setWind(glm::vec3(0.f), 0.5f);
+			}, HairRenderer::Mode::RIBBONS, 0.02f, scale });
+		}
+
+		// Hair hanging into a 16x16 bed of small spheres, broadphase keeps per-particle cost close to idle-hang
+		scenarios.push_back({ "colliders-256", 2000, [](Hair& hair, uint32_t frame, float) {
+			if (frame != 0)
+				return;
+
+			hair.setWind(glm::vec3(0.f), 0.f);
+			for (uint32_t i = 0; i < 256; ++i)
+				hair.getColliders().add(ColliderSet::makeSphere(glm::vec3(((float)(i % 16) - 7.5f) * 0.6f, -4.f, ((float)(i / 16) - 7.5f) * 0.6f), 0.2f));
+		}});
+
+		// Voxel field used by friction rebuilt every N steps, final positions are compared against interval 1
+		for (uint32_t interval : { 1U, 2U, 4U, 8U })
+		{
+			scenarios.push_back({ "volume-interval-" + std::to_string(interval), 2000, [interval](Hair& hair, uint32_t frame, float) {
+				if (frame == 0)
+				{
+					hair.setWind(glm::vec3(0.f), 0.5f);
+					hair.setVolumeUpdateInterval(interval);
+				}
+			}});
+		}
+
+		// XPBD solver with increasing iteration count against follow-the-leader in dynamic-wind
+		for (uint32_t iterations : { 1U, 4U, 16U })
+		{
+			scenarios.push_back({ "xpbd-iterations-" + std::to_string(iterations), 2000, [iterations](Hair& hair, uint32_t frame, float) {
+				if (frame == 0)
+				{
+					hair.setWind(glm::vec3(0.f), 0.5f);
+					hair.setSolver(Hair::Solver::XPBD);
+					hair.setSolverIterations(iterations);
+				}
+			}});
+		}
+
+		// 10x10 crowd of heads, every stage is a single dispatch and hair is drawn with one indirect multi-draw
+		for (bool culling : { false, true })
+		{
+			scenarios.push_back({ culling ? "crowd-100-culled" : "crowd-100", 2000, [](Hair&, uint32_t, float) {},
+				HairRenderer::Mode::GEOMETRY_SHADER, 0.f, 0.f, false, 100, culling });
+		}
+
+		return scenarios;
+	}
+
+	Unique<HairSystem> createCrowd(const Scenario& scenario, uint32_t seed)
+	{
+		const uint32_t rowLength = (uint32_t)glm::ceil(glm::sqrt((float)scenario.instanceCount));
+		std::vector<glm::mat4> transforms;
+		for (uint32_t i = 0; i < scenario.instanceCount; ++i)
+		{
+			const glm::vec3 position(((float)(i % rowLength) - 0.5f * (rowLength - 1)) * 8.f, 0.f, -8.f * (float)(i / rowLength));
+			transforms.push_back(glm::translate(glm::mat4(1.f), position));
+		}
+
+		Unique<HairSystem> crowd = std::make_unique<HairSystem>(transforms, scenario.strandCount, 4.f, scenario.curlRadius, seed);
+		for (uint32_t i = 0; i < scenario.instanceCount; ++i)
+			crowd->setWind(i, glm::vec3(0.f), 0.5f);
+
+		crowd->setCulledSimulationInterval(scenario.culling ? 4 : 1);
+
+		return crowd;
+	}
+
+	ScenarioResult runScenario(const Scenario& scenario, const Settings& settings, Window& window, HairRenderer& hairRenderer, const Camera& cam)
+	{
+		Unique<HairSystem> crowd = scenario.instanceCount > 0 ? createCrowd(scenario, settings.seed) : nullptr;
+		Unique<Hair> hair = crowd ? nullptr : std::make_unique<Hair>(scenario.strandCount, 4.f, scenario.curlRadius, settings.seed);
+		Hair& scenarioHair = crowd ? crowd->getPrototype() : *hair;
+		hairRenderer.setMode(scenario.renderMode);
+		hairRenderer.setCulling(scenario.culling);
+		hairRenderer.setOrderIndependentTransparency(scenario.transparencyScale > 0.f);
+		if (scenario.transparencyScale > 0.f)
+			hairRenderer.getTransparencyBuffer().setResolutionScale(scenario.transparencyScale);
+		scenarioHair.color = glm::vec3(0.45f, 0.18f, 0.012f);
+
+		GpuTimer simulationTimer, drawingTimer;
+		GpuCounter fragmentCounter;
+		std::vector<double> simulationTimes, drawingTimes, frameTimes, fragmentCounts, activeStrandCounts;
+		simulationTimes.reserve(settings.frames);
+		drawingTimes.reserve(settings.frames);
+		frameTimes.reserve(settings.frames);
+		fragmentCounts.reserve(settings.frames);
+		activeStrandCounts.reserve(settings.frames);
+
+		for (uint32_t frame = 0; frame < settings.warmupFrames + settings.frames; ++frame)
+		{
+			const float runningTime = frame * timeStep;
+			scenario.update(scenarioHair, frame, runningTime);
+
+			auto frameStart = std::chrono::steady_clock::now();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			simulationTimer.begin();
+			if (crowd)
+				crowd->applyPhysics(timeStep, runningTime);
+			else
+				hair->applyPhysics(timeStep, runningTime);
+			simulationTimer.end();
+
+			drawingTimer.begin();
+			if (scenario.depthPrepass && hair)
+				hairRenderer.drawDepth(*hair, cam);
+
+			fragmentCounter.begin();
+			if (crowd)
+				hairRenderer.draw(*crowd, cam);
+			else
+				hairRenderer.draw(*hair, cam);
+			fragmentCounter.end();
+			drawingTimer.end();
+
+			glFinish();
+			auto frameEnd = std::chrono::steady_clock::now();
+
+			if (frame >= settings.warmupFrames)
+			{
+				simulationTimes.push_back(simulationTimer.getElapsedMilliseconds());
+				drawingTimes.push_back(drawingTimer.getElapsedMilliseconds());
+				frameTimes.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+				fragmentCounts.push_back(fragmentCounter.getCount() / 1e6);
+				activeStrandCounts.push_back(crowd ? crowd->getStrandCount() : hair->getActiveStrandCount());
+			}
+
+			window.onUpdate();
+		}
+
+		std::vector<float> positions, velocities;
+		if (hair)
+			hair->readParticleState(positions, velocities);
+
+		const uint32_t totalStrandCount = crowd ? crowd->getStrandCount() : scenario.strandCount;
+		return { scenario.name, totalStrandCount, computeStatistics(simulationTimes), computeStatistics(drawingTimes), computeStatistics(frameTimes), computeStatistics(fragmentCounts), computeStatistics(activeStrandCounts), std::move(positions) };
+	}
+
+	// Fills position error of volume interval scenarios, compared against volume-interval-1 run with them
+	void compareVolumeIntervals(std::vector<ScenarioResult>& results)
+	{
+		const auto reference = std::find_if(results.begin(), results.end(), [](const ScenarioResult& result) { return result.name == "volume-interval-1"; });
+		if (reference == results.end())
+			return;
+
+		for (auto& result : results)
+		{
+			if (result.name.rfind("volume-interval-", 0) != 0 || result.positions.size() != reference->positions.size())
+				continue;
+
+			double squaredError = 0.0;
+			for (size_t i = 0; i < result.positions.size(); i += 3)
+			{
+				const glm::vec3 difference(result.positions[i] - reference->positions[i], result.positions[i + 1] - reference->positions[i + 1],
+					result.positions[i + 2] - reference->positions[i + 2]);
+				squaredError += glm::dot(difference, difference);
+			}
+			result.positionError = result.positions.empty() ? 0.0 : std::sqrt(squaredError / (result.positions.size() / 3));
+		}
+	}
+
+	void printResults(const std::vector<ScenarioResult>& results)
+	{
+		std::cout << std::left << std::setw(24) << "Scenario" << std::right << std::setw(8) << "Strands"
+			<< std::setw(12) << "Sim mean" << std::setw(12) << "Sim p95"
+			<< std::setw(12) << "Draw mean" << std::setw(12) << "Draw p95"
+			<< std::setw(12) << "Frame mean" << std::setw(12) << "Frame p95" << std::setw(12) << "Hair FS" << std::setw(10) << "Active" << '\n';
+
+		std::cout << std::fixed << std::setprecision(3);
+		for (const auto& result : results)
+		{
+			std::cout << std::left << std::setw(24) << result.name << std::right << std::setw(8) << result.strandCount
+				<< std::setw(12) << result.simulation.mean << std::setw(12) << result.simulation.percentile95
+				<< std::setw(12) << result.drawing.mean << std::setw(12) << result.drawing.percentile95
+				<< std::setw(12) << result.frame.mean << std::setw(12) << result.frame.percentile95 << std::setw(12) << result.fragments.mean
+				<< std::setw(10) << std::setprecision(0) << result.activeStrands.mean << std::setprecision(3) << '\n';
+		}
+
+		std::cout << "All times are in milliseconds, hair fragment shader invocations in millions per frame, active is mean count of simulated strands." << std::endl;
+
+		// Quality/cost curve of voxel field update interval
+		if (std::none_of(results.begin(), results.end(), [](const ScenarioResult& result) { return result.positionError >= 0.0; }))
+			return;
+
+		std::cout << '\n' << std::left << std::setw(24) << "Volume interval" << std::right << std::setw(12) << "Sim mean" << std::setw(16) << "Position RMS" << '\n';
+		for (const auto& result : results)
+		{
+			if (result.positionError >= 0.0)
+			{
+				std::cout << std::left << std::setw(24) << result.name << std::right << std::setw(12) << std::setprecision(3) << result.simulation.mean
+					<< std::setw(16) << std::setprecision(5) << result.positionError << '\n';
+			}
+		}
+		std::cout << std::setprecision(3) << "Position RMS is distance from volume-interval-1 after the last frame." << std::endl;
+	}
+
+	void writeCsv(const std::string& fileName, const std::vector<ScenarioResult>& results)
+	{
+		std::ofstream file(fileName);
+		if (!file)
+		{
+			std::cout << "Failed to open '" << fileName << "' for writing!" << std::endl;
+			return;
+		}
+
+		file << "scenario,strands";
+		for (const char* stage : { "sim", "draw", "frame" })
+		{
+			for (const char* statistic : { "mean", "min", "max", "median", "p95", "stddev" })
+				file << ',' << stage << '_' << statistic << "_ms";
+		}
+		file << ",fragments_mean_millions,active_strands_mean,position_rms";
+		file << '\n';
+
+		for (const auto& result : results)
+		{
+			file << result.name << ',' << result.strandCount;
+			for (const Statistics* statistics : { &result.simulation, &result.drawing, &result.frame })
+			{
+				file << ',' << statistics->mean << ',' << statistics->minimum << ',' << statistics->maximum
+					<< ',' << statistics->median << ',' << statistics->percentile95 << ',' << statistics->standardDeviation;
+			}
+			file << ',' << result.fragments.mean << ',' << result.activeStrands.mean << ',';
+			if (result.positionError >= 0.0)
+				file << result.positionError;
+			file << '\n';
+		}
+	}
+
+	void printUsage()
+	{
+		std::cout << "Usage: HairBenchmark [--frames N] [--warmup N] [--seed N] [--scenario NAME] [--csv FILE]" << std::endl;
+	}
+
+	bool parseArguments(int argc, char** argv, Settings& settings)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string argument = argv[i];
+			if (i + 1 >= argc)
+				return false;
+
+			const std::string value = argv[++i];
+			if (argument == "--frames")
+				settings.frames = std::stoul(value);
+			else if (argument == "--warmup")
+				settings.warmupFrames = std::stoul(value);
+			else if (argument == "--seed")
+				settings.seed = std::stoul(value);
+			else if (argument == "--scenario")
+				settings.scenarioFilter = value;
+			else if (argument == "--csv")
+				settings.csvFile = value;
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Settings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		printUsage();
+		return 1;
+	}
+
+	Unique<Window> window = std::make_unique<Window>(1440, 810, "Hair Benchmark", 4, false);
+	glfwSwapInterval(0);
+	glEnable(GL_MULTISAMPLE);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	glClearColor(0.1f, 0.1f, 0.1f, 1.f);
+	glViewport(0, 0, 1440, 810);
+
+	PerspectiveCamera cam;
+	cam.setProjectionAspectRatio(1440.f / 810);
+	cam.setPosition(glm::vec3(-5.f, 3.f, 5.f));
+	cam.setCenter(glm::vec3(0.f));
+	cam.setProjectionViewingAngle(100.f);
+
+	HairRenderer hairRenderer;
+	hairRenderer.setLight(glm::vec3(1.f, 2.f, 1.f), glm::vec3(1.f));
+
+	std::vector<ScenarioResult> results;
+	for (const auto& scenario : createScenarios())
+	{
+		if (!settings.scenarioFilter.empty() && scenario.name.find(settings.scenarioFilter) == std::string::npos)
+			continue;
+
+		std::cout << "Running scenario: " << scenario.name << std::endl;
+		results.push_back(runScenario(scenario, settings, *window, hairRenderer, cam));
+	}
+
+	compareVolumeIntervals(results);
+	printResults(results);
+	if (!settings.csvFile.empty())
+		writeCsv(settings.csvFile, results);
+
+	return 0;
+}
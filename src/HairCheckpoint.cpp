@@ -0,0 +1,116 @@
+#include "HairCheckpoint.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	const char checkpointMagic[4] = { 'H', 'C', 'K', 'P' };
+
+	// Particle arrays start at 16 byte boundaries
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~uint64_t(15);
+	}
+}
+
+bool HairCheckpoint::save(const std::string& fileName, const Header& fields, const float* positions, const float* velocities, const float* restShape,
+	const void* strandAttributes, const void* roots)
+{
+	// Copied byte by byte, so padding zeroed by the caller stays zero in the file
+	Header header;
+	std::memcpy(&header, &fields, sizeof(Header));
+	std::memcpy(header.magic, checkpointMagic, sizeof(checkpointMagic));
+	header.version = currentVersion;
+
+	const uint64_t particleDataSize = (uint64_t)header.strandCapacity * header.particlesPerStrand * 3 * sizeof(float);
+	header.positionsOffset = alignOffset(sizeof(Header));
+	header.velocitiesOffset = alignOffset(header.positionsOffset + particleDataSize);
+	header.restShapeOffset = alignOffset(header.velocitiesOffset + particleDataSize);
+	header.strandAttributesOffset = alignOffset(header.restShapeOffset + particleDataSize);
+	header.rootsOffset = alignOffset(header.strandAttributesOffset + (uint64_t)header.strandCapacity * header.strandAttributeSize);
+
+	std::ofstream checkpointFile(fileName, std::ios::binary);
+	if (!checkpointFile)
+	{
+		std::cout << "Failed to open '" << fileName << "' for writing!" << std::endl;
+		return false;
+	}
+
+	const char padding[16] = {};
+	checkpointFile.write((const char*)&header, sizeof(Header));
+	checkpointFile.write(padding, header.positionsOffset - sizeof(Header));
+	checkpointFile.write((const char*)positions, particleDataSize);
+	checkpointFile.write(padding, header.velocitiesOffset - header.positionsOffset - particleDataSize);
+	checkpointFile.write((const char*)velocities, particleDataSize);
+	checkpointFile.write(padding, header.restShapeOffset - header.velocitiesOffset - particleDataSize);
+	checkpointFile.write((const char*)restShape, particleDataSize);
+	checkpointFile.write(padding, header.strandAttributesOffset - header.restShapeOffset - particleDataSize);
+	checkpointFile.write((const char*)strandAttributes, (uint64_t)header.strandCapacity * header.strandAttributeSize);
+	checkpointFile.write(padding, header.rootsOffset - header.strandAttributesOffset - (uint64_t)header.strandCapacity * header.strandAttributeSize);
+	checkpointFile.write((const char*)roots, (uint64_t)header.strandCapacity * header.rootSize);
+	return bool(checkpointFile);
+}
+
+HairCheckpoint::HairCheckpoint(const std::string& fileName) : file(fileName)
+{
+	if (!file.isOpen())
+	{
+		std::cout << "Checkpoint '" << fileName << "' doesn't exist!" << std::endl;
+		return;
+	}
+
+	const Header* mappedHeader = reinterpret_cast<const Header*>(file.getData());
+	if (file.getSize() < sizeof(Header) || std::memcmp(mappedHeader->magic, checkpointMagic, sizeof(checkpointMagic)) != 0)
+	{
+		std::cout << "File '" << fileName << "' is not a hair checkpoint!" << std::endl;
+		return;
+	}
+
+	if (mappedHeader->version != currentVersion)
+	{
+		std::cout << "Checkpoint '" << fileName << "' has unsupported version " << mappedHeader->version << ", expected version " << currentVersion << "!" << std::endl;
+		return;
+	}
+
+	const uint64_t particleDataSize = (uint64_t)mappedHeader->strandCapacity * mappedHeader->particlesPerStrand * 3 * sizeof(float);
+	if (mappedHeader->positionsOffset + particleDataSize > file.getSize() || mappedHeader->velocitiesOffset + particleDataSize > file.getSize()
+		|| mappedHeader->restShapeOffset + particleDataSize > file.getSize()
+		|| mappedHeader->strandAttributesOffset + (uint64_t)mappedHeader->strandCapacity * mappedHeader->strandAttributeSize > file.getSize()
+		|| mappedHeader->rootsOffset + (uint64_t)mappedHeader->strandCapacity * mappedHeader->rootSize > file.getSize())
+	{
+		std::cout << "Checkpoint '" << fileName << "' is truncated!" << std::endl;
+		return;
+	}
+
+	header = mappedHeader;
+}
+
+const float* HairCheckpoint::getPositions() const
+{
+	return reinterpret_cast<const float*>(file.getData() + header->positionsOffset);
+}
+
+const float* HairCheckpoint::getVelocities() const
+{
+	return reinterpret_cast<const float*>(file.getData() + header->velocitiesOffset);
+}
+
+const float* HairCheckpoint::getRestShape() const
+{
+	return reinterpret_cast<const float*>(file.getData() + header->restShapeOffset);
+}
+
+const void* HairCheckpoint::getStrandAttributes() const
+{
+	return file.getData() + header->strandAttributesOffset;
+}
+
+const void* HairCheckpoint::getRoots() const
+{
+	return file.getData() + header->rootsOffset;
+}
+
+size_t HairCheckpoint::getParticleDataSize() const
+{
+	return (size_t)header->strandCapacity * header->particlesPerStrand * 3 * sizeof(float);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+
+/*
+* Binary snapshot of hair simulation state.
+* File consists of a fixed size header followed by positions, velocities and rest shape of all strands (3 floats per
+* particle), so particle data can be uploaded to GPU buffers straight from memory mapped file. Per-strand attributes
+* and roots follow as raw structs, so restored hair doesn't depend on root placement inputs present on disk.
+*/
+class HairCheckpoint {
+public:
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t strandCount;			// Active strands
+		uint32_t strandCapacity;		// Strands stored in file
+		uint32_t particlesPerStrand;
+		uint32_t randomSeed;
+		uint32_t strandAttributeSize;	// Bytes per strand of attribute and root arrays
+		uint32_t rootSize;
+		uint64_t positionsOffset;		// Byte offsets from the start of the file
+		uint64_t velocitiesOffset;
+		uint64_t restShapeOffset;
+		uint64_t strandAttributesOffset;
+		uint64_t rootsOffset;
+
+		// Simulation parameters
+		float hairLength;
+		float curlRadius;
+		float strandWidth;
+		float particleMass;
+		float gravity;
+		float wind[4];
+		float frictionFactor;
+		float velocityDampingCoefficient;
+		float bendingStiffness;
+		float shapeStiffness;
+
+		// Head transform
+		float translation[3];
+		float rotation[4];				// Quaternion as w, x, y, z
+		float scale[3];
+	};
+
+	static constexpr uint32_t currentVersion = 3;
+
+	/*
+	* Writes header and particle data, magic, version and offsets are filled in here.
+	* Header is written as raw bytes, so the caller clears it with memset before setting its fields.
+	*/
+	static bool save(const std::string& fileName, const Header& fields, const float* positions, const float* velocities, const float* restShape,
+		const void* strandAttributes, const void* roots);
+
+	HairCheckpoint(const std::string& fileName);
+
+	// File exists, has a matching version and isn't truncated
+	bool isValid() const { return header != nullptr; }
+	const Header& getHeader() const { return *header; }
+	const float* getPositions() const;
+	const float* getVelocities() const;
+	const float* getRestShape() const;
+	const void* getStrandAttributes() const;
+	const void* getRoots() const;
+	size_t getParticleDataSize() const;
+
+private:
+	MappedFile file;
+	const Header* header = nullptr;
+};
@@ -0,0 +1,105 @@
+#include "HairCuller.h"
+#include "Hair.h"
+#include "HairSystem.h"
+#include "HierarchicalDepth.h"
+#include "Camera.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_access.hpp>
+
+namespace {
+	constexpr GLsizeiptr commandSize = 4 * sizeof(GLuint);		// DrawArraysIndirectCommand
+	constexpr GLuint strandMode = 0;
+	constexpr GLuint instanceMode = 1;
+}
+
+HairCuller::HairCuller() :
+	cullShader("HairCullComputeShader.glsl")
+{
+	const GLuint zero = 0;
+	glGenBuffers(1, &countBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_DRAW);
+	glGenBuffers(1, &commandBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+}
+
+HairCuller::~HairCuller()
+{
+	glDeleteBuffers(1, &commandBuffer);
+	glDeleteBuffers(1, &countBuffer);
+}
+
+void HairCuller::cull(const Hair& hair, const Camera& camera, const HierarchicalDepth* occluders)
+{
+	// Curl and strand width are added to the particle bounds, so expanded strands stay inside their spheres
+	cullShader.use();
+	cullShader.setUint("mode", strandMode);
+	cullShader.setMat4("model", hair.getTransformMatrix());
+	cullShader.setUint("particlesPerStrand", hair.getParticlesPerStrand());
+	cullShader.setFloat("radiusMargin", 1.5f * hair.getCurlRadius() + hair.getStrandWidth());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, hair.getPositionBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, hair.getStrandAttributeBuffer());
+	dispatch(hair.getStrandCount(), camera, occluders);
+}
+
+void HairCuller::cull(const HairSystem& system, const Camera& camera, const HierarchicalDepth* occluders)
+{
+	const Hair& prototype = system.getPrototype();
+	cullShader.use();
+	cullShader.setUint("mode", instanceMode);
+	cullShader.setFloat("instanceRadius", prototype.getBoundingRadius() + 1.5f * prototype.getCurlRadius());
+	cullShader.setUint("instanceVertexCount", system.getStrandsPerInstance() * (prototype.getParticlesPerStrand() - 1) * 2);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, system.getInstanceBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, system.getVisibilityBuffer());
+	dispatch(system.getInstanceCount(), camera, occluders);
+}
+
+uint32_t HairCuller::getVisibleCount() const
+{
+	GLuint count = 0;
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glGetNamedBufferSubData(countBuffer, 0, sizeof(GLuint), &count);
+	return count;
+}
+
+void HairCuller::dispatch(uint32_t itemCount, const Camera& camera, const HierarchicalDepth* occluders)
+{
+	// Buffer only grows, so changing strand count back and forth doesn't reallocate
+	if (itemCount > commandCapacity)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, itemCount * commandSize, nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+		commandCapacity = itemCount;
+	}
+
+	const GLuint zero = 0;
+	glClearNamedBufferData(countBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, countBuffer);
+
+	// Frustum planes extracted from rows of view projection matrix, normals point inside
+	const glm::mat4 viewProjection = camera.getProjection() * camera.getView();
+	glm::vec4 planes[6];
+	for (int i = 0; i < 6; ++i)
+	{
+		planes[i] = glm::row(viewProjection, 3) + (i % 2 == 0 ? 1.f : -1.f) * glm::row(viewProjection, i / 2);
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+
+	cullShader.setVec4Array("frustumPlanes", 6, planes);
+
+	const glm::mat4& projection = camera.getProjection();
+	cullShader.setMat4("view", camera.getView());
+	cullShader.setMat4("projection", projection);
+	cullShader.setFloat("nearPlane", projection[3][2] / (projection[2][2] - 1.f));
+	cullShader.setUint("itemCount", itemCount);
+	cullShader.setBool("occlusionCulling", occluders != nullptr);
+	if (occluders)
+		occluders->bind(cullShader, 2);
+
+	const GLuint localWorkGroupCountX = cullShader.getLocalWorkGroupsCount().x;
+	cullShader.setGlobalWorkGroupCount((itemCount + localWorkGroupCountX - 1) / localWorkGroupCountX);
+	cullShader.dispatch();
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
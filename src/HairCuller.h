@@ -0,0 +1,46 @@
+#pragma once
+#include "ComputeShader.h"
+#include <glad/glad.h>
+#include <cstdint>
+
+class Hair;
+class HairSystem;
+class Camera;
+class HierarchicalDepth;
+
+/*
+* GPU frustum and occlusion culling of hair, without any readback to CPU.
+* Strands of a single hair are tested by bounding spheres of their simulated particles, instances of a hair system
+* by bounding spheres around their origins. Visible ones are compacted into DrawArraysIndirectCommands together with
+* their count, which indirect count draws read straight from the buffers. Instance visibility is also written to the
+* hair system, so culled instances can be simulated at a lower rate.
+* Occlusion is tested against the hierarchical depth of opaque scene when one is given, spheres crossing the near
+* plane are always visible.
+*/
+class HairCuller {
+public:
+	HairCuller();
+	~HairCuller();
+	HairCuller(const HairCuller&) = delete;
+	HairCuller& operator=(const HairCuller&) = delete;
+
+	// Writes a line strip command for every visible strand, see Hair::drawIndirect
+	void cull(const Hair& hair, const Camera& camera, const HierarchicalDepth* occluders);
+
+	// Writes a command for every visible instance with the same layout as HairSystem::getDrawCommandBuffer
+	void cull(const HairSystem& system, const Camera& camera, const HierarchicalDepth* occluders);
+	GLuint getCommandBuffer() const { return commandBuffer; }
+
+	// Number of compacted commands as a single uint
+	GLuint getCountBuffer() const { return countBuffer; }
+
+	// Reads back count of the last cull, waits for GPU
+	uint32_t getVisibleCount() const;
+
+private:
+	void dispatch(uint32_t itemCount, const Camera& camera, const HierarchicalDepth* occluders);
+	ComputeShader cullShader;
+	GLuint commandBuffer = GL_NONE;
+	GLuint countBuffer = GL_NONE;
+	uint32_t commandCapacity = 0;
+};
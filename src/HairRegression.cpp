@@ -0,0 +1,291 @@
+#include "Window.h"
+#include "Hair.h"
+#include "ParticleSnapshot.h"
+#include "PathConfig.h"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+template<typename T> using Unique = std::unique_ptr<T>;
+
+namespace {
+	constexpr float timeStep = 1.f / 60.f;
+
+	struct Settings {
+		bool record = false;
+		uint32_t steps = 240;
+		uint32_t seed = 1;
+		double positionTolerance = 1e-3;
+		double velocityTolerance = 1e-2;
+		std::string goldenFolder = GOLDEN_FOLDER;
+		std::string reportFile;
+	};
+
+	struct Scenario {
+		std::string name;
+
+		// Called before every simulation step with step index and simulation running time
+		std::function<void(Hair&, uint32_t, float)> update;
+
+		// Hair is saved to a checkpoint and replaced by hair restored from it before this step, 0 never
+		uint32_t checkpointStep = 0;
+	};
+
+	std::vector<Scenario> createScenarios()
+	{
+		std::vector<Scenario> scenarios;
+
+		scenarios.push_back({ "idle-hang", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+				hair.setWind(glm::vec3(0.f), 0.f);
+		}});
+
+		scenarios.push_back({ "constant-wind", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+				hair.setWind(glm::vec3(1.f, 0.f, 0.3f), 0.5f);
+		}});
+
+		scenarios.push_back({ "dynamic-wind", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+				hair.setWind(glm::vec3(0.f), 0.5f);
+		}});
+
+		scenarios.push_back({ "head-rotation", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+				hair.setWind(glm::vec3(0.f), 0.f);
+
+			if (step < 60)
+				hair.rotate(1.f, glm::vec3(0.f, 1.f, 0.f));
+		}});
+
+		scenarios.push_back({ "high-friction", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+			{
+				hair.setWind(glm::vec3(0.f), 0.5f);
+				hair.setFrictionFactor(0.2f);
+			}
+		}});
+
+		scenarios.push_back({ "xpbd", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+			{
+				hair.setWind(glm::vec3(0.f), 0.5f);
+				hair.setSolver(Hair::Solver::XPBD);
+			}
+
+			if (step < 60)
+				hair.rotate(1.f, glm::vec3(0.f, 1.f, 0.f));
+		}});
+
+		scenarios.push_back({ "sleeping", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+			{
+				hair.setWind(glm::vec3(0.f), 0.f);
+				hair.setSleeping(true);
+			}
+
+			// Strands asleep by then are woken by the head moving
+			if (step >= 180 && step < 200)
+				hair.rotate(1.f, glm::vec3(0.f, 1.f, 0.f));
+		}});
+
+		// Sphere moving 0.2 per step through hanging hair is swept, not just tested at its end position
+		scenarios.push_back({ "moving-collider", [sphere = 0U](Hair& hair, uint32_t step, float) mutable {
+			const glm::vec3 center(-4.f + glm::min(step, 40U) * 0.2f, -2.5f, 0.f);
+			if (step == 0)
+			{
+				hair.setWind(glm::vec3(0.f), 0.f);
+				sphere = hair.getColliders().add(ColliderSet::makeSphere(center, 0.3f));
+			}
+			else
+			{
+				hair.getColliders().set(sphere, ColliderSet::makeSphere(center, 0.3f));
+			}
+		}});
+
+		scenarios.push_back({ "volume-repulsion", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+			{
+				hair.setWind(glm::vec3(0.f), 0.f);
+				hair.setVolumeRepulsion(1.f);
+			}
+		}});
+
+		// Pose blown by wind becomes the rest shape, which then holds against gravity
+		scenarios.push_back({ "rest-shape", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+				hair.setWind(glm::vec3(1.f, 0.f, 0.3f), 0.5f);
+
+			if (step == 120)
+			{
+				hair.captureRestShape();
+				hair.setWind(glm::vec3(0.f), 0.f);
+				hair.setBendingStiffness(0.5f);
+				hair.setShapeStiffness(0.2f);
+			}
+		}});
+
+		// Continues from restored checkpoint halfway, so positions, velocities, rest shape and roots round trip
+		scenarios.push_back({ "checkpoint-restore", [](Hair& hair, uint32_t step, float) {
+			if (step == 0)
+				hair.setWind(glm::vec3(1.f, 0.f, 0.3f), 0.5f);
+		}, 120 });
+
+		return scenarios;
+	}
+
+	ParticleSnapshot simulateScenario(const Scenario& scenario, const Settings& settings)
+	{
+		Unique<Hair> hair = std::make_unique<Hair>(2000, 4.f, 0.f, settings.seed);
+		for (uint32_t step = 0; step < settings.steps; ++step)
+		{
+			const float runningTime = step * timeStep;
+			if (step > 0 && step == scenario.checkpointStep)
+			{
+				const std::string checkpointFile = (std::filesystem::temp_directory_path() / "HairRegression.checkpoint").string();
+				hair->saveCheckpoint(checkpointFile);
+				hair = std::make_unique<Hair>(checkpointFile);
+				std::filesystem::remove(checkpointFile);
+			}
+
+			scenario.update(*hair, step, runningTime);
+			hair->applyPhysics(timeStep, runningTime);
+		}
+
+		glFinish();
+
+		ParticleSnapshot snapshot;
+		snapshot.strandCount = hair->getStrandCount();
+		snapshot.particlesPerStrand = hair->getParticlesPerStrand();
+		snapshot.stepCount = settings.steps;
+		hair->readParticleState(snapshot.positions, snapshot.velocities);
+		return snapshot;
+	}
+
+	void reportMetrics(std::ostream& report, const char* name, const ErrorMetrics& metrics, uint32_t particlesPerStrand)
+	{
+		report << "  " << std::left << std::setw(11) << name << std::right << std::scientific << std::setprecision(3)
+			<< " max " << metrics.maximum << "  mean " << metrics.mean << "  rms " << metrics.rootMeanSquare
+			<< "  worst strand " << metrics.worstParticle / particlesPerStrand << " particle " << metrics.worstParticle % particlesPerStrand << '\n';
+	}
+
+	void printUsage()
+	{
+		std::cout << "Usage: HairRegression [--record] [--steps N] [--seed N] [--position-tolerance X] [--velocity-tolerance X] [--golden FOLDER] [--report FILE]" << std::endl;
+	}
+
+	bool parseArguments(int argc, char** argv, Settings& settings)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string argument = argv[i];
+			if (argument == "--record")
+			{
+				settings.record = true;
+				continue;
+			}
+
+			if (i + 1 >= argc)
+				return false;
+
+			const std::string value = argv[++i];
+			if (argument == "--steps")
+				settings.steps = std::stoul(value);
+			else if (argument == "--seed")
+				settings.seed = std::stoul(value);
+			else if (argument == "--position-tolerance")
+				settings.positionTolerance = std::stod(value);
+			else if (argument == "--velocity-tolerance")
+				settings.velocityTolerance = std::stod(value);
+			else if (argument == "--golden")
+				settings.goldenFolder = value + "/";
+			else if (argument == "--report")
+				settings.reportFile = value;
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Settings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		printUsage();
+		return 1;
+	}
+
+	// Only compute work is done, so hidden window is enough even on software rasterizers
+	Unique<Window> window = std::make_unique<Window>(64, 64, "Hair Regression", 1, false);
+
+	std::stringstream report;
+	bool allPassed = true;
+
+	if (settings.record)
+		std::filesystem::create_directories(settings.goldenFolder);
+
+	for (const auto& scenario : createScenarios())
+	{
+		const std::string goldenFile = settings.goldenFolder + scenario.name + ".snapshot";
+		ParticleSnapshot tested = simulateScenario(scenario, settings);
+
+		if (settings.record)
+		{
+			bool saved = tested.save(goldenFile);
+			report << scenario.name << ": " << (saved ? "recorded" : "FAILED TO RECORD") << '\n';
+			allPassed = allPassed && saved;
+			continue;
+		}
+
+		ParticleSnapshot reference;
+		if (!reference.load(goldenFile))
+		{
+			report << scenario.name << ": FAILED (missing golden snapshot, run with --record first)\n";
+			allPassed = false;
+			continue;
+		}
+
+		if (reference.stepCount != tested.stepCount)
+		{
+			report << scenario.name << ": FAILED (golden snapshot recorded with " << reference.stepCount << " steps)\n";
+			allPassed = false;
+			continue;
+		}
+
+		SnapshotComparison comparison = compareSnapshots(reference, tested);
+		if (!comparison.layoutMatches)
+		{
+			report << scenario.name << ": FAILED (strand layout differs from golden snapshot)\n";
+			allPassed = false;
+			continue;
+		}
+
+		// Negated comparison so NaN errors fail
+		bool passed = !(comparison.positions.maximum > settings.positionTolerance) && !(comparison.velocities.maximum > settings.velocityTolerance);
+		allPassed = allPassed && passed;
+
+		report << scenario.name << ": " << (passed ? "passed" : "FAILED") << '\n';
+		reportMetrics(report, "positions", comparison.positions, tested.particlesPerStrand);
+		reportMetrics(report, "velocities", comparison.velocities, tested.particlesPerStrand);
+	}
+
+	report << (allPassed ? "All scenarios passed." : "Some scenarios failed!") << '\n';
+	std::cout << report.str();
+
+	if (!settings.reportFile.empty())
+	{
+		std::ofstream reportFile(settings.reportFile);
+		reportFile << report.str();
+	}
+
+	return allPassed ? 0 : 1;
+}
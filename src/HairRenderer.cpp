@@ -0,0 +1,329 @@
+#include "HairRenderer.h"
+#include "Hair.h"
+#include "HairSystem.h"
+#include "Camera.h"
+#include <glm/glm.hpp>
+
+namespace {
+	constexpr GLsizeiptr curledVertexSize = 2 * 4 * sizeof(float);		// Position and tangent
+}
+
+HairRenderer::HairRenderer() :
+	geometryShaderProgram("HairVertexShader.glsl", "HairGeometryShader.glsl", "HairFragmentShader.glsl"),
+	tessellationProgram("HairSegmentVertexShader.glsl", "HairTessControlShader.glsl", "HairTessEvaluationShader.glsl", "HairFragmentShader.glsl"),
+	curledLineProgram("HairCurledLineVertexShader.glsl", "HairFragmentShader.glsl"),
+	ribbonProgram("HairRibbonVertexShader.glsl", "HairFragmentShader.glsl"),
+	instancedProgram("HairInstanceVertexShader.glsl", "HairGeometryShader.glsl", "HairFragmentShader.glsl"),
+	geometryShaderDepthProgram("HairVertexShader.glsl", "HairGeometryShader.glsl", "DepthFragmentShader.glsl"),
+	tessellationDepthProgram("HairSegmentVertexShader.glsl", "HairTessControlShader.glsl", "HairTessEvaluationShader.glsl", "DepthFragmentShader.glsl"),
+	curledLineDepthProgram("HairCurledLineVertexShader.glsl", "DepthFragmentShader.glsl"),
+	curlComputeShader("HairCurlComputeShader.glsl")
+{
+	glCreateVertexArrays(1, &emptyVao);
+	glGenBuffers(1, &curledVertexBuffer);
+}
+
+HairRenderer::~HairRenderer()
+{
+	glDeleteVertexArrays(1, &emptyVao);
+	glDeleteBuffers(1, &curledVertexBuffer);
+}
+
+const char* HairRenderer::getModeName(Mode renderMode)
+{
+	switch (renderMode)
+	{
+		case Mode::GEOMETRY_SHADER:
+			return "geometry shader";
+		case Mode::TESSELLATION:
+			return "tessellation";
+		case Mode::COMPUTE:
+			return "compute";
+		case Mode::RIBBONS:
+			return "ribbons";
+	}
+
+	return "unknown";
+}
+
+void HairRenderer::setSubdivisionCount(uint32_t count)
+{
+	subdivisionCount = glm::clamp<uint32_t>(count, 1U, 64U);
+}
+
+uint32_t HairRenderer::getLodSubdivisionCount(float distance) const
+{
+	// Same rule as HairTessControlShader
+	const float count = glm::round((float)subdivisionCount * lodDistance / glm::max(distance, 1e-3f));
+	return (uint32_t)glm::clamp(count, 1.f, (float)subdivisionCount);
+}
+
+void HairRenderer::setLight(const glm::vec3& position, const glm::vec3& color)
+{
+	lightPosition = position;
+	for (const DrawingShader* shader : { &geometryShaderProgram, &tessellationProgram, &curledLineProgram, &ribbonProgram, &instancedProgram })
+	{
+		shader->use();
+		shader->setVec3("light.position", position);
+		shader->setVec3("light.color", color);
+		shader->setFloat("light.constant", 1.f);
+		shader->setFloat("light.linear", 0.024f);
+		shader->setFloat("light.quadratic", 0.0021f);
+	}
+}
+
+bool HairRenderer::supportsDepthPrepass() const
+{
+	// Transparent and partially covering strands must not hide strands behind them
+	return !orderIndependent && mode != Mode::RIBBONS;
+}
+
+void HairRenderer::drawDepth(const Hair& hair, const Camera& camera)
+{
+	depthPrepassed = false;
+	occludersReady = culling;
+	if (culling)
+		occluderDepth.update();
+
+	if (hair.getStrandCount() == 0 || !supportsDepthPrepass())
+		return;
+
+	bindSimulationBuffers(hair);
+	if (mode == Mode::COMPUTE)
+		curledPointsPerStrand = updateCurledVertices(hair, camera);
+	else if (mode == Mode::GEOMETRY_SHADER && culling)
+		culler.cull(hair, camera, &occluderDepth);
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	drawStrands(hair, camera, true);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	depthPrepassed = true;
+}
+
+void HairRenderer::draw(const Hair& hair, const Camera& camera)
+{
+	const bool equalDepth = depthPrepassed && supportsDepthPrepass();
+	depthPrepassed = false;
+	if (hair.getStrandCount() == 0)
+		return;
+
+	bindSimulationBuffers(hair);
+	if (selfShadowing)
+		opacityMap.render(hair, lightPosition);
+
+	// Curled strands and culled commands from depth prepass are reused, so both passes rasterize exactly the same lines
+	if ((mode == Mode::COMPUTE && !equalDepth) || mode == Mode::RIBBONS)
+		curledPointsPerStrand = updateCurledVertices(hair, camera);
+	else if (mode == Mode::GEOMETRY_SHADER && culling && !equalDepth)
+		culler.cull(hair, camera, occludersReady ? &occluderDepth : nullptr);
+
+	// After prepass only the nearest strand fragment of every pixel is shaded
+	GLint depthFunction = GL_LESS;
+	if (equalDepth)
+	{
+		glGetIntegerv(GL_DEPTH_FUNC, &depthFunction);
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+
+	if (orderIndependent)
+		transparencyBuffer.begin();
+
+	drawStrands(hair, camera, false);
+	if (orderIndependent)
+		transparencyBuffer.end();
+
+	if (equalDepth)
+	{
+		glDepthFunc(depthFunction);
+		glDepthMask(GL_TRUE);
+	}
+}
+
+void HairRenderer::draw(const HairSystem& system, const Camera& camera)
+{
+	depthPrepassed = false;
+	if (system.getInstanceCount() == 0)
+		return;
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	const GLuint visible = 1;
+	if (culling)
+		culler.cull(system, camera, occludersReady ? &occluderDepth : nullptr);
+	else
+		glClearNamedBufferData(system.getVisibilityBuffer(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &visible);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, system.getPositionBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, system.getStrandAttributeBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, system.getInstanceBuffer());
+
+	const Hair& prototype = system.getPrototype();
+	setCameraUniforms(instancedProgram, prototype, camera);
+	instancedProgram.setBool("selfShadowing", false);
+	instancedProgram.setFloat("curlRadius", prototype.getCurlRadius());
+	instancedProgram.setUint("particlesPerStrand", prototype.getParticlesPerStrand());
+	instancedProgram.setUint("strandsPerInstance", system.getStrandsPerInstance());
+
+	if (orderIndependent)
+		transparencyBuffer.begin();
+
+	glBindVertexArray(emptyVao);
+	if (culling)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.getCommandBuffer());
+		glBindBuffer(GL_PARAMETER_BUFFER, culler.getCountBuffer());
+		glMultiDrawArraysIndirectCount(GL_LINES, nullptr, 0, system.getInstanceCount(), 0);
+		glBindBuffer(GL_PARAMETER_BUFFER, GL_NONE);
+	}
+	else
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, system.getDrawCommandBuffer());
+		glMultiDrawArraysIndirect(GL_LINES, nullptr, system.getInstanceCount(), 0);
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GL_NONE);
+	glBindVertexArray(GL_NONE);
+	if (orderIndependent)
+		transparencyBuffer.end();
+}
+
+void HairRenderer::bindSimulationBuffers(const Hair& hair) const
+{
+	// Positions were written by simulation compute shader, either as vertex attributes or storage buffer
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, hair.getPositionBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, hair.getStrandAttributeBuffer());
+}
+
+void HairRenderer::drawStrands(const Hair& hair, const Camera& camera, bool depthOnly)
+{
+	switch (mode)
+	{
+		case Mode::GEOMETRY_SHADER:
+		{
+			const DrawingShader& program = depthOnly ? geometryShaderDepthProgram : geometryShaderProgram;
+			setCameraUniforms(program, hair, camera);
+			program.setMat4("model", hair.getTransformMatrix());
+			program.setFloat("curlRadius", hair.getCurlRadius());
+			program.setUint("particlesPerStrand", hair.getParticlesPerStrand());
+			if (culling)
+				hair.drawIndirect(culler.getCommandBuffer(), culler.getCountBuffer());
+			else
+				hair.draw();
+			break;
+		}
+
+		case Mode::TESSELLATION:
+			drawTessellated(hair, camera, depthOnly ? tessellationDepthProgram : tessellationProgram);
+			break;
+
+		case Mode::COMPUTE:
+			drawComputeCurled(hair, camera, depthOnly ? curledLineDepthProgram : curledLineProgram);
+			break;
+
+		case Mode::RIBBONS:
+			drawRibbons(hair, camera);
+			break;
+	}
+}
+
+void HairRenderer::setCameraUniforms(const DrawingShader& shader, const Hair& hair, const Camera& camera) const
+{
+	shader.use();
+	shader.setMat4("projection", camera.getProjection());
+	shader.setMat4("view", camera.getView());
+	shader.setVec3("eyePosition", camera.getPosition());
+	shader.setBool("orderIndependent", orderIndependent);
+	shader.setFloat("opacity", orderIndependent ? opacity : 1.f);
+	shader.setBool("selfShadowing", selfShadowing);
+	opacityMap.bind(shader, 3);
+	marschnerLut.bind(shader, 4);
+	hair.updateColorsBasedOnMaterial(shader, material);
+}
+
+void HairRenderer::drawTessellated(const Hair& hair, const Camera& camera, const DrawingShader& program) const
+{
+	setCameraUniforms(program, hair, camera);
+	program.setMat4("model", hair.getTransformMatrix());
+	program.setFloat("curlRadius", hair.getCurlRadius());
+	program.setUint("particlesPerStrand", hair.getParticlesPerStrand());
+	program.setFloat("subdivisionCount", (float)subdivisionCount);
+	program.setFloat("lodDistance", lodDistance);
+
+	// Every patch is a single segment
+	glBindVertexArray(emptyVao);
+	glPatchParameteri(GL_PATCH_VERTICES, 1);
+	glDrawArrays(GL_PATCHES, 0, hair.getStrandCount() * (hair.getParticlesPerStrand() - 1));
+	glBindVertexArray(GL_NONE);
+}
+
+uint32_t HairRenderer::updateCurledVertices(const Hair& hair, const Camera& camera)
+{
+	// Every strand needs the same number of points for fixed layout of the buffer, so LOD is chosen for the whole hair
+	const glm::vec3 hairOrigin = hair.getTransformMatrix()[3];
+	const uint32_t lodSubdivisionCount = getLodSubdivisionCount(glm::distance(camera.getPosition(), hairOrigin));
+	const uint32_t strandCount = hair.getStrandCount();
+	const uint32_t pointsPerStrand = (hair.getParticlesPerStrand() - 1) * lodSubdivisionCount + 1;
+	const uint32_t pointCount = strandCount * pointsPerStrand;
+
+	// Buffer only grows, so changing strand count back and forth doesn't reallocate
+	const GLsizeiptr requiredSize = (GLsizeiptr)pointCount * curledVertexSize;
+	if (requiredSize > curledVertexBufferSize)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, curledVertexBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, requiredSize, nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+		curledVertexBufferSize = requiredSize;
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, curledVertexBuffer);
+	curlComputeShader.use();
+	curlComputeShader.setMat4("model", hair.getTransformMatrix());
+	curlComputeShader.setUint("particlesPerStrand", hair.getParticlesPerStrand());
+	curlComputeShader.setUint("strandCount", strandCount);
+	curlComputeShader.setUint("subdivisionCount", lodSubdivisionCount);
+	curlComputeShader.setFloat("curlRadius", hair.getCurlRadius());
+	const GLuint localWorkGroupCountX = curlComputeShader.getLocalWorkGroupsCount().x;
+	curlComputeShader.setGlobalWorkGroupCount((pointCount + localWorkGroupCountX - 1) / localWorkGroupCountX);
+	curlComputeShader.dispatch();
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	return pointsPerStrand;
+}
+
+void HairRenderer::drawComputeCurled(const Hair& hair, const Camera& camera, const DrawingShader& program)
+{
+	const uint32_t strandCount = hair.getStrandCount();
+	const uint32_t pointsPerStrand = curledPointsPerStrand;
+	if (strandFirsts.size() != strandCount || (strandCount > 0 && strandCounts[0] != (GLsizei)pointsPerStrand))
+	{
+		strandFirsts.resize(strandCount);
+		strandCounts.assign(strandCount, pointsPerStrand);
+		for (uint32_t i = 0; i < strandCount; ++i)
+			strandFirsts[i] = i * pointsPerStrand;
+	}
+
+	setCameraUniforms(program, hair, camera);
+	program.setUint("pointsPerStrand", pointsPerStrand);
+	glBindVertexArray(emptyVao);
+	glMultiDrawArrays(GL_LINE_STRIP, strandFirsts.data(), strandCounts.data(), strandCount);
+	glBindVertexArray(GL_NONE);
+}
+
+void HairRenderer::drawRibbons(const Hair& hair, const Camera& camera) const
+{
+	const uint32_t pointsPerStrand = curledPointsPerStrand;
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	setCameraUniforms(ribbonProgram, hair, camera);
+	ribbonProgram.setUint("pointsPerStrand", pointsPerStrand);
+	ribbonProgram.setFloat("strandWidth", hair.getStrandWidth());
+	ribbonProgram.setFloat("viewportHeight", (float)viewport[3]);
+
+	// Coverage goes to multisample mask, so ribbons don't need sorting
+	glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+	glBindVertexArray(emptyVao);
+	glDrawArrays(GL_TRIANGLES, 0, hair.getStrandCount() * (pointsPerStrand - 1) * 6);
+	glBindVertexArray(GL_NONE);
+	glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+}
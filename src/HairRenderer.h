@@ -0,0 +1,127 @@
+#pragma once
+#include "DrawingShader.h"
+#include "ComputeShader.h"
+#include "WeightedBlendedOit.h"
+#include "DeepOpacityMap.h"
+#include "MarschnerLut.h"
+#include "HairCuller.h"
+#include "HierarchicalDepth.h"
+#include "Entity.h"
+#include <glm/common.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <vector>
+
+class Hair;
+class HairSystem;
+class Camera;
+
+/*
+* Draws simulated hair with one of interchangeable curl expansion paths.
+* GEOMETRY_SHADER expands every segment in HairGeometryShader, TESSELLATION does the same with isoline tessellation
+* and COMPUTE writes curled strands into a vertex buffer once per frame, which is then drawn as plain line strips.
+* RIBBONS expands the same curled strands into camera facing quads of hair strand width, strands thinner than a pixel
+* are drawn a pixel wide with alpha to coverage proportional to their footprint.
+* Tessellation and compute paths read particle positions and strand attributes straight from simulation buffers
+* and smooth simulated strands with a Catmull-Rom spline through the particles.
+* Hair systems are always expanded in the geometry shader, all their instances with one indirect multi-draw.
+* With culling, strands of geometry shader path and hair system instances outside the view or hidden behind the head
+* depth written before drawDepth are dropped on GPU and the rest is drawn with indirect count draws.
+*/
+class HairRenderer {
+public:
+	enum class Mode {
+		GEOMETRY_SHADER,
+		TESSELLATION,
+		COMPUTE,
+		RIBBONS
+	};
+
+	HairRenderer();
+	~HairRenderer();
+	HairRenderer(const HairRenderer&) = delete;
+	HairRenderer& operator=(const HairRenderer&) = delete;
+	void setMode(Mode renderMode) { mode = renderMode; }
+	Mode getMode() const { return mode; }
+	static const char* getModeName(Mode renderMode);
+
+	// Number of line pieces every segment is split into by tessellation and compute paths, clamped in range [1, 64]
+	void setSubdivisionCount(uint32_t count);
+	uint32_t getSubdivisionCount() const { return subdivisionCount; }
+
+	// Segments closer than LOD distance get full subdivision, further ones proportionally less down to a single piece.
+	// Tessellation picks it per segment, compute path per hair from distance to its origin.
+	void setLodDistance(float distance) { lodDistance = glm::max(distance, 0.f); }
+	float getLodDistance() const { return lodDistance; }
+	uint32_t getLodSubdivisionCount(float distance) const;
+
+	// Transparent strands are blended with the given opacity, clamped in range [0.05, 1]
+	void setOrderIndependentTransparency(bool enabled) { orderIndependent = enabled; }
+	bool getOrderIndependentTransparency() const { return orderIndependent; }
+	void setOpacity(float strandOpacity) { opacity = glm::clamp(strandOpacity, 0.05f, 1.f); }
+	float getOpacity() const { return opacity; }
+	WeightedBlendedOit& getTransparencyBuffer() { return transparencyBuffer; }
+	void setSelfShadowing(bool enabled) { selfShadowing = enabled; }
+	bool getSelfShadowing() const { return selfShadowing; }
+	DeepOpacityMap& getOpacityMap() { return opacityMap; }
+	void setMaterial(Entity::Material hairMaterial) { material = hairMaterial; }
+	Entity::Material getMaterial() const { return material; }
+	void setLight(const glm::vec3& position, const glm::vec3& color);
+	void setCulling(bool enabled) { culling = enabled; }
+	bool getCulling() const { return culling; }
+	const HairCuller& getCuller() const { return culler; }
+
+	/*
+	* Writes only depth of hair, so the following draw() shades just the visible strand fragments with GL_EQUAL test.
+	* Skipped for ribbons and transparent hair, which can't hide strands behind them.
+	* With culling, depth already in the framebuffer is taken as occluders for this and following draws.
+	*/
+	void drawDepth(const Hair& hair, const Camera& camera);
+	bool supportsDepthPrepass() const;
+	void draw(const Hair& hair, const Camera& camera);
+
+	// Draws every instance of the system, without depth prepass and self-shadowing which are fitted to a single hair
+	void draw(const HairSystem& system, const Camera& camera);
+
+private:
+	void setCameraUniforms(const DrawingShader& shader, const Hair& hair, const Camera& camera) const;
+	void bindSimulationBuffers(const Hair& hair) const;
+	void drawStrands(const Hair& hair, const Camera& camera, bool depthOnly);
+	void drawTessellated(const Hair& hair, const Camera& camera, const DrawingShader& program) const;
+	void drawComputeCurled(const Hair& hair, const Camera& camera, const DrawingShader& program);
+	void drawRibbons(const Hair& hair, const Camera& camera) const;
+
+	// Fills curled vertex buffer and returns number of points per strand
+	uint32_t updateCurledVertices(const Hair& hair, const Camera& camera);
+	DrawingShader geometryShaderProgram;
+	DrawingShader tessellationProgram;
+	DrawingShader curledLineProgram;
+	DrawingShader ribbonProgram;
+	DrawingShader instancedProgram;
+	DrawingShader geometryShaderDepthProgram;
+	DrawingShader tessellationDepthProgram;
+	DrawingShader curledLineDepthProgram;
+	ComputeShader curlComputeShader;
+	WeightedBlendedOit transparencyBuffer;
+	DeepOpacityMap opacityMap;
+	MarschnerLut marschnerLut;
+	HairCuller culler;
+	HierarchicalDepth occluderDepth;
+	Entity::Material material = Entity::Material::HAIR_MARSCHNER;
+	Mode mode = Mode::GEOMETRY_SHADER;
+	uint32_t subdivisionCount = 9;
+	float lodDistance = 8.f;
+	bool orderIndependent = false;
+	bool selfShadowing = true;
+	bool culling = false;
+	bool occludersReady = false;		// Set by drawDepth with culling, occluder depth is used until the next drawDepth
+	glm::vec3 lightPosition{ 0.f };
+	float opacity = 0.6f;
+	GLuint emptyVao = GL_NONE;		// Vertex pulling paths have no vertex attributes
+	GLuint curledVertexBuffer = GL_NONE;
+	GLsizeiptr curledVertexBufferSize = 0;
+	uint32_t curledPointsPerStrand = 0;
+	bool depthPrepassed = false;		// Set by drawDepth and consumed by the next draw
+	std::vector<GLint> strandFirsts;
+	std::vector<GLsizei> strandCounts;
+};
@@ -0,0 +1,260 @@
+#include "HairSystem.h"
+#include "HeadDistanceField.h"
+#include <glm/glm.hpp>
+
+namespace {
+	constexpr GLsizeiptr voxelGridSize = 11 * 11 * 11 * sizeof(int);		// 10x10x10 voxels, 11 vertices per dimension
+
+	struct DrawArraysIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;
+		GLuint baseInstance;
+	};
+}
+
+HairSystem::HairSystem(const std::vector<glm::mat4>& instanceTransforms, uint32_t strandsPerInstance, float hairLength, float hairCurlRadius, uint32_t randomSeed) :
+	computeShader("HairComputeShader.glsl")
+{
+	prototype = std::make_unique<Hair>(strandsPerInstance, hairLength, hairCurlRadius, randomSeed);
+	prototype->setStrandCount(strandsPerInstance);
+	this->strandsPerInstance = prototype->getStrandCount();
+	particlesPerStrand = prototype->getParticlesPerStrand();
+
+	// Head ellipsoids of every instance are colliders for hair of all instances
+	for (const glm::mat4& model : instanceTransforms)
+	{
+		instances.push_back(prototype->makeInstance(model));
+		simulatedModels.push_back(model);
+		culledSimulatedModels.push_back(model);
+		for (const auto& collider : prototype->makeEllipsoidColliders(model))
+			colliders.add(collider);
+	}
+
+	// Prototype hasn't been simulated yet, so its buffers still hold strands in their initial pose
+	std::vector<float> positions, velocities;
+	prototype->readParticleState(positions, velocities);
+	std::vector<float> restShape(positions.size());
+	glGetNamedBufferSubData(prototype->getRestShapeBuffer(), 0, restShape.size() * sizeof(float), restShape.data());
+	std::vector<StrandAttributes> attributes(this->strandsPerInstance);
+	glGetNamedBufferSubData(prototype->getStrandAttributeBuffer(), 0, attributes.size() * sizeof(StrandAttributes), attributes.data());
+
+	createBuffers(positions, restShape, attributes);
+	createDrawCommands();
+
+	computeShader.use();
+	computeShader.setUint("hairData.strandCount", getStrandCount());
+	computeShader.setUint("hairData.particlesPerStrand", particlesPerStrand);
+	computeShader.setUint("hairData.strandsPerInstance", this->strandsPerInstance);
+}
+
+HairSystem::~HairSystem()
+{
+	glDeleteBuffers(1, &positionBuffer);
+	glDeleteBuffers(1, &velocityBuffer);
+	glDeleteBuffers(1, &volumeDensities);
+	glDeleteBuffers(1, &volumeVelocities);
+	glDeleteBuffers(1, &strandAttributeBuffer);
+	glDeleteBuffers(1, &restShapeBuffer);
+	glDeleteBuffers(1, &instanceBuffer);
+	glDeleteBuffers(1, &drawCommandBuffer);
+	glDeleteBuffers(1, &visibilityBuffer);
+	glDeleteBuffers(1, &culledTransformBuffer);
+}
+
+void HairSystem::createBuffers(const std::vector<float>& prototypePositions, const std::vector<float>& prototypeRestShape,
+	const std::vector<StrandAttributes>& prototypeAttributes)
+{
+	// Roots stay in hair local space, other particles are moved to world space of every instance
+	const size_t floatsPerInstance = prototypePositions.size();
+	std::vector<float> positions(floatsPerInstance * instances.size());
+	std::vector<float> restShape;
+	std::vector<StrandAttributes> attributes;
+	restShape.reserve(prototypeRestShape.size() * instances.size());
+	attributes.reserve(prototypeAttributes.size() * instances.size());
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		for (size_t particle = 0; particle < floatsPerInstance / 3; ++particle)
+		{
+			glm::vec3 position(prototypePositions[particle * 3], prototypePositions[particle * 3 + 1], prototypePositions[particle * 3 + 2]);
+			if (particle % particlesPerStrand != 0)
+				position = glm::vec3(instances[i].model * glm::vec4(position, 1.f));
+
+			float* destination = &positions[i * floatsPerInstance + particle * 3];
+			destination[0] = position.x;
+			destination[1] = position.y;
+			destination[2] = position.z;
+		}
+
+		restShape.insert(restShape.end(), prototypeRestShape.begin(), prototypeRestShape.end());
+		attributes.insert(attributes.end(), prototypeAttributes.begin(), prototypeAttributes.end());
+	}
+
+	const GLsizeiptr particleDataSize = (GLsizeiptr)positions.size() * sizeof(float);
+	const float zero = 0.f;
+	glGenBuffers(1, &positionBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, positionBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, particleDataSize, positions.data(), GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &velocityBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, velocityBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, particleDataSize, nullptr, GL_DYNAMIC_DRAW);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, &zero);
+
+	// One voxel grid per instance
+	glGenBuffers(1, &volumeDensities);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeDensities);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize * instances.size(), nullptr, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &volumeVelocities);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeVelocities);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize * 3 * instances.size(), nullptr, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &strandAttributeBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, strandAttributeBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, attributes.size() * sizeof(StrandAttributes), attributes.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &restShapeBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, restShapeBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, restShape.size() * sizeof(float), restShape.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(HairInstance), instances.data(), GL_DYNAMIC_DRAW);
+
+	// Every instance is visible until it is culled
+	const GLuint visible = 1;
+	glGenBuffers(1, &visibilityBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibilityBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &visible);
+
+	glGenBuffers(1, &culledTransformBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, culledTransformBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(CulledTransform), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+	instancesChanged = false;
+}
+
+void HairSystem::createDrawCommands()
+{
+	// Vertex IDs start from zero for every command, instance offsets come from base instance
+	std::vector<DrawArraysIndirectCommand> commands(instances.size());
+	for (size_t i = 0; i < commands.size(); ++i)
+		commands[i] = { strandsPerInstance * (particlesPerStrand - 1) * 2, 1, 0, (GLuint)i };
+
+	glGenBuffers(1, &drawCommandBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawArraysIndirectCommand), commands.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GL_NONE);
+}
+
+void HairSystem::setInstanceTransform(uint32_t index, const glm::mat4& model)
+{
+	const glm::vec4 wind = instances[index].wind;
+	instances[index] = prototype->makeInstance(model);
+	instances[index].wind = wind;
+	instancesChanged = true;
+
+	const std::vector<ColliderSet::Collider> ellipsoidColliders = prototype->makeEllipsoidColliders(model);
+	for (uint32_t i = 0; i < ellipsoidColliders.size(); ++i)
+		colliders.set(index * ellipsoidCount + i, ellipsoidColliders[i]);
+}
+
+void HairSystem::setWind(uint32_t index, const glm::vec3& direction, float strength)
+{
+	instances[index].wind = glm::vec4(direction, glm::clamp(strength, 0.f, 1.f));
+	instancesChanged = true;
+}
+
+void HairSystem::applyPhysics(float deltaTime, float runningTime)
+{
+	if (instances.empty())
+		return;
+
+	// Head collision of every instance is swept from its transform of the previous step
+	if (instancesChanged || instancesMoving)
+	{
+		instancesMoving = false;
+		for (size_t i = 0; i < instances.size(); ++i)
+		{
+			if (simulatedModels[i] != instances[i].previousModel)
+			{
+				instances[i].previousModel = simulatedModels[i];
+				instances[i].previousInverseModel = glm::inverse(simulatedModels[i]);
+			}
+
+			instancesMoving = instancesMoving || instances[i].previousModel != instances[i].model;
+			simulatedModels[i] = instances[i].model;
+		}
+
+		glNamedBufferSubData(instanceBuffer, 0, instances.size() * sizeof(HairInstance), instances.data());
+		instancesChanged = false;
+	}
+
+	// Culled instances run only in every culledSimulationInterval-th step, swept from the transform of the last such step
+	const bool culledInstancesRun = stepIndex % culledSimulationInterval == 0;
+	if (culledInstancesRun)
+	{
+		if (culledSimulationInterval > 1)
+		{
+			std::vector<CulledTransform> culledTransforms(instances.size());
+			for (size_t i = 0; i < instances.size(); ++i)
+				culledTransforms[i] = { culledSimulatedModels[i], glm::inverse(culledSimulatedModels[i]) };
+
+			glNamedBufferSubData(culledTransformBuffer, 0, culledTransforms.size() * sizeof(CulledTransform), culledTransforms.data());
+		}
+
+		for (size_t i = 0; i < instances.size(); ++i)
+			culledSimulatedModels[i] = instances[i].model;
+	}
+
+	const int zero = 0;
+	glClearNamedBufferData(volumeDensities, GL_R32I, GL_RED_INTEGER, GL_INT, &zero);
+	glClearNamedBufferData(volumeVelocities, GL_R32I, GL_RED_INTEGER, GL_INT, &zero);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positionBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocityBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, volumeDensities);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, volumeVelocities);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, strandAttributeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, visibilityBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 18, restShapeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 19, culledTransformBuffer);
+
+	// Every stage runs once over strands or particles of all instances
+	const GLuint strandCount = getStrandCount();
+	const GLuint particleCount = strandCount * particlesPerStrand;
+	const GLuint localWorkGroupCountX = computeShader.getLocalWorkGroupsCount().x;
+	computeShader.use();
+	computeShader.setFloat("deltaTime", deltaTime);
+	computeShader.setFloat("runningTime", runningTime);
+	computeShader.setBool("distanceFieldCollision", prototype->getDistanceFieldCollision());
+	prototype->bindSolver(computeShader);
+	if (prototype->getDistanceFieldCollision())
+		prototype->getDistanceField()->bind(computeShader, 0);
+
+	for (uint32_t i = 0; i < getInstanceCount() * ellipsoidCount; ++i)
+		colliders.setEnabled(i, !prototype->getDistanceFieldCollision());
+
+	colliders.update();
+	colliders.bind(computeShader);
+
+	computeShader.setBool("skipCulledInstances", !culledInstancesRun);
+	computeShader.setUint("culledStepCount", culledSimulationInterval);
+	computeShader.setUint("headEllipsoidColliderCount", getInstanceCount() * ellipsoidCount);
+	stepIndex = (stepIndex + 1) % culledSimulationInterval;
+	computeShader.setUint("state", 0);
+	computeShader.setGlobalWorkGroupCount((strandCount + localWorkGroupCountX - 1) / localWorkGroupCountX);
+	computeShader.dispatch();
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	computeShader.setGlobalWorkGroupCount((particleCount + localWorkGroupCountX - 1) / localWorkGroupCountX);
+	computeShader.setUint("state", 1);
+	computeShader.dispatch();
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	computeShader.setUint("state", 2);
+	computeShader.dispatch();
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "Hair.h"
+#include "ComputeShader.h"
+#include <glad/glad.h>
+#include <glm/common.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+* Many copies of one generated hair simulated and drawn together, e.g. a crowd of heads.
+* Every instance has the same strands as the prototype hair and its own transform, collision ellipsoids and forces.
+* Particles, strand attributes and voxel grids of all instances are packed into shared buffers, so every simulation
+* stage is a single dispatch over all instances and drawing is one indirect multi-draw with one command per instance.
+*/
+class HairSystem {
+public:
+	// One instance is created for every transform, strands start hanging straight from their roots
+	HairSystem(const std::vector<glm::mat4>& instanceTransforms, uint32_t strandsPerInstance = 2000U, float hairLength = 4.f, float hairCurlRadius = 0.f, uint32_t randomSeed = 1U);
+	~HairSystem();
+	HairSystem(const HairSystem&) = delete;
+	HairSystem& operator=(const HairSystem&) = delete;
+
+	/*
+	* Moves instance to a new transform, strands follow it through the simulation like hair of a moving head.
+	* Wind of the instance is kept, other parameters are taken from the prototype.
+	*/
+	void setInstanceTransform(uint32_t index, const glm::mat4& model);
+	const glm::mat4& getInstanceTransform(uint32_t index) const { return instances[index].model; }
+
+	// Same meaning as Hair::setWind, for a single instance
+	void setWind(uint32_t index, const glm::vec3& direction, float strength);
+
+	// Same meaning as Hair::getColliders, first 7 colliders of every instance in order are its head ellipsoids
+	ColliderSet& getColliders() { return colliders; }
+
+	/*
+	* Instances culled by the last HairCuller pass are simulated only every given step, 1 simulates all of them every step.
+	* When they are, they advance by all the skipped steps and their head collision is swept through the whole motion.
+	*/
+	void setCulledSimulationInterval(uint32_t steps) { culledSimulationInterval = glm::max(steps, 1U); }
+	uint32_t getCulledSimulationInterval() const { return culledSimulationInterval; }
+	void applyPhysics(float deltaTime, float runningTime);
+
+	// Head mesh, material color and curl radius shared by all instances
+	Hair& getPrototype() { return *prototype; }
+	const Hair& getPrototype() const { return *prototype; }
+	uint32_t getInstanceCount() const { return (uint32_t)instances.size(); }
+	uint32_t getStrandsPerInstance() const { return strandsPerInstance; }
+	uint32_t getStrandCount() const { return getInstanceCount() * strandsPerInstance; }
+	GLuint getPositionBuffer() const { return positionBuffer; }
+	GLuint getStrandAttributeBuffer() const { return strandAttributeBuffer; }
+	GLuint getInstanceBuffer() const { return instanceBuffer; }
+
+	// Uint per instance, 1 for visible instances, written by HairCuller
+	GLuint getVisibilityBuffer() const { return visibilityBuffer; }
+
+	// DrawArraysIndirectCommand per instance drawing its segments as GL_LINES, base instance is the instance index
+	GLuint getDrawCommandBuffer() const { return drawCommandBuffer; }
+
+private:
+	// std430 layout of CulledTransform in HairComputeShader
+	struct CulledTransform {
+		glm::mat4 previousModel;
+		glm::mat4 previousInverseModel;
+	};
+
+	void createBuffers(const std::vector<float>& prototypePositions, const std::vector<float>& prototypeRestShape,
+		const std::vector<StrandAttributes>& prototypeAttributes);
+	void createDrawCommands();
+	std::unique_ptr<Hair> prototype;
+	ComputeShader computeShader;
+	std::vector<HairInstance> instances;
+	ColliderSet colliders;
+	static constexpr uint32_t ellipsoidCount = 7;
+	uint32_t strandsPerInstance;
+	uint32_t particlesPerStrand;
+	std::vector<glm::mat4> simulatedModels;		// Transforms of the last simulation step
+	std::vector<glm::mat4> culledSimulatedModels;		// Transforms of the last step simulating culled instances
+	bool instancesChanged = true;
+	bool instancesMoving = false;		// Some instance moved in the last step, previous transforms have to catch up
+	uint32_t culledSimulationInterval = 1;
+	uint32_t stepIndex = 0;
+	GLuint positionBuffer = GL_NONE;
+	GLuint velocityBuffer = GL_NONE;
+	GLuint volumeDensities = GL_NONE;
+	GLuint volumeVelocities = GL_NONE;
+	GLuint strandAttributeBuffer = GL_NONE;
+	GLuint restShapeBuffer = GL_NONE;		// Rest shape of the prototype repeated for every instance
+	GLuint instanceBuffer = GL_NONE;
+	GLuint drawCommandBuffer = GL_NONE;
+	GLuint visibilityBuffer = GL_NONE;
+	GLuint culledTransformBuffer = GL_NONE;
+};
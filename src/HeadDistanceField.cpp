@@ -0,0 +1,290 @@
+#include "HeadDistanceField.h"
+#include "HeadMeshCache.h"
+#include "ParallelFor.h"
+#include "Shader.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace {
+	const char distanceFieldMagic[4] = { 'H', 'S', 'D', 'F' };
+	constexpr uint32_t distanceFieldVersion = 1;
+	constexpr float boundsPadding = 0.15f;		// Relative to the largest mesh extent on every side
+	constexpr float bandTexels = 3.f;			// Width of exactly computed band around triangles
+
+	struct DistanceFieldHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t resolution;
+		uint32_t padding;
+		uint64_t inputHash;
+	};
+
+	// FNV-1a
+	uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+
+		return hash;
+	}
+
+	// Real-Time Collision Detection, 5.1.5, returns barycentric weights of the closest point
+	glm::vec3 closestPointWeights(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+		const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if (d1 <= 0.f && d2 <= 0.f)
+			return glm::vec3(1.f, 0.f, 0.f);
+
+		const glm::vec3 bp = p - b;
+		const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if (d3 >= 0.f && d4 <= d3)
+			return glm::vec3(0.f, 1.f, 0.f);
+
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+		{
+			const float v = d1 / (d1 - d3);
+			return glm::vec3(1.f - v, v, 0.f);
+		}
+
+		const glm::vec3 cp = p - c;
+		const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d6 >= 0.f && d5 <= d6)
+			return glm::vec3(0.f, 0.f, 1.f);
+
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+		{
+			const float w = d2 / (d2 - d6);
+			return glm::vec3(1.f - w, 0.f, w);
+		}
+
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+		{
+			const float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			return glm::vec3(0.f, 1.f - w, w);
+		}
+
+		const float denominator = 1.f / (va + vb + vc);
+		const float v = vb * denominator, w = vc * denominator;
+		return glm::vec3(1.f - v - w, v, w);
+	}
+}
+
+HeadDistanceField::HeadDistanceField(const HeadMeshCache& headMesh, const std::string& cacheFileName, uint32_t gridResolution) :
+	resolution(std::max(gridResolution, 4U))
+{
+	if (!headMesh.isValid() || headMesh.getIndexCount() < 3)
+		return;
+
+	const float* vertexData = headMesh.getVertexData();
+	const uint32_t* indices = headMesh.getIndices();
+	std::vector<Triangle> triangles(headMesh.getIndexCount() / 3);
+	glm::vec3 meshMinimum(std::numeric_limits<float>::max()), meshMaximum(std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i < triangles.size(); ++i)
+	{
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			const float* vertex = &vertexData[(size_t)indices[i * 3 + j] * HeadMeshCache::floatsPerVertex];
+			triangles[i].positions[j] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+			triangles[i].normals[j] = glm::vec3(vertex[3], vertex[4], vertex[5]);
+			meshMinimum = glm::min(meshMinimum, triangles[i].positions[j]);
+			meshMaximum = glm::max(meshMaximum, triangles[i].positions[j]);
+		}
+	}
+
+	// Cubic grid centered on the mesh
+	const float extent = glm::max(meshMaximum.x - meshMinimum.x, glm::max(meshMaximum.y - meshMinimum.y, meshMaximum.z - meshMinimum.z));
+	size = extent * (1.f + 2.f * boundsPadding);
+	minimum = 0.5f * (meshMinimum + meshMaximum) - 0.5f * size;
+
+	uint64_t inputHash = hashBytes(0xcbf29ce484222325ULL, vertexData, (size_t)headMesh.getVertexCount() * HeadMeshCache::floatsPerVertex * sizeof(float));
+	inputHash = hashBytes(inputHash, indices, (size_t)headMesh.getIndexCount() * sizeof(uint32_t));
+
+	std::vector<float> texels;
+	if (!readCache(cacheFileName, inputHash, texels))
+	{
+		texels = bake(triangles);
+		writeCache(cacheFileName, inputHash, texels);
+	}
+
+	glCreateTextures(GL_TEXTURE_3D, 1, &texture);
+	glTextureStorage3D(texture, 1, GL_RGBA16F, resolution, resolution, resolution);
+	glTextureSubImage3D(texture, 0, 0, 0, 0, resolution, resolution, resolution, GL_RGBA, GL_FLOAT, texels.data());
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+HeadDistanceField::~HeadDistanceField()
+{
+	glDeleteTextures(1, &texture);
+}
+
+void HeadDistanceField::bind(const Shader& shader, GLuint textureUnit) const
+{
+	shader.setInt("headDistanceField", textureUnit);
+	shader.setVec3("distanceFieldMinimum", minimum);
+	shader.setFloat("distanceFieldSize", size);
+	glBindTextureUnit(textureUnit, texture);
+}
+
+glm::vec3 HeadDistanceField::getTexelCenter(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return minimum + (glm::vec3(x, y, z) + 0.5f) * (size / resolution);
+}
+
+std::vector<float> HeadDistanceField::bake(const std::vector<Triangle>& triangles) const
+{
+	const float texelSize = size / resolution;
+	const float band = bandTexels * texelSize;
+	const size_t sliceSize = (size_t)resolution * resolution;
+	auto toTexel = [this, texelSize](float coordinate, float origin) {
+		return (int)glm::clamp(glm::floor((coordinate - origin) / texelSize - 0.5f), 0.f, (float)resolution - 1.f);
+	};
+
+	// Triangles are bucketed by z slices their band overlaps, so every slice can be filled on its own thread
+	std::vector<std::vector<uint32_t>> sliceTriangles(resolution);
+	for (uint32_t i = 0; i < (uint32_t)triangles.size(); ++i)
+	{
+		const Triangle& triangle = triangles[i];
+		const float lowest = glm::min(triangle.positions[0].z, glm::min(triangle.positions[1].z, triangle.positions[2].z)) - band;
+		const float highest = glm::max(triangle.positions[0].z, glm::max(triangle.positions[1].z, triangle.positions[2].z)) + band;
+		for (int z = toTexel(lowest, minimum.z); z <= toTexel(highest, minimum.z) + 1 && z < (int)resolution; ++z)
+			sliceTriangles[z].push_back(i);
+	}
+
+	// Exact signed distance in the band, sign is taken from interpolated vertex normal at the closest point
+	const float unknown = std::numeric_limits<float>::max();
+	std::vector<float> distances(sliceSize * resolution, unknown);
+	parallelFor(resolution, [&](uint32_t z) {
+		std::vector<float> absoluteDistances(sliceSize, unknown);
+		for (uint32_t index : sliceTriangles[z])
+		{
+			const Triangle& triangle = triangles[index];
+			const glm::vec3 lowest = glm::min(triangle.positions[0], glm::min(triangle.positions[1], triangle.positions[2])) - band;
+			const glm::vec3 highest = glm::max(triangle.positions[0], glm::max(triangle.positions[1], triangle.positions[2])) + band;
+			for (int y = toTexel(lowest.y, minimum.y); y <= toTexel(highest.y, minimum.y) + 1 && y < (int)resolution; ++y)
+			{
+				for (int x = toTexel(lowest.x, minimum.x); x <= toTexel(highest.x, minimum.x) + 1 && x < (int)resolution; ++x)
+				{
+					const glm::vec3 position = getTexelCenter(x, y, z);
+					const glm::vec3 weights = closestPointWeights(position, triangle.positions[0], triangle.positions[1], triangle.positions[2]);
+					const glm::vec3 closest = triangle.positions[0] * weights.x + triangle.positions[1] * weights.y + triangle.positions[2] * weights.z;
+					const float distance = glm::length(position - closest);
+					const size_t texel = (size_t)y * resolution + x;
+					if (distance >= band || distance >= absoluteDistances[texel])
+						continue;
+
+					const glm::vec3 normal = triangle.normals[0] * weights.x + triangle.normals[1] * weights.y + triangle.normals[2] * weights.z;
+					absoluteDistances[texel] = distance;
+					distances[z * sliceSize + texel] = glm::dot(position - closest, normal) >= 0.f ? distance : -distance;
+				}
+			}
+		}
+	});
+
+	// Texels outside the band connected to the grid border are outside of the head, the rest of them is inside
+	std::vector<uint32_t> stack;
+	auto visit = [&](uint32_t x, uint32_t y, uint32_t z) {
+		const size_t texel = z * sliceSize + (size_t)y * resolution + x;
+		if (distances[texel] != unknown)
+			return;
+
+		distances[texel] = band;
+		stack.push_back((uint32_t)texel);
+	};
+
+	for (uint32_t i = 0; i < resolution; ++i)
+	{
+		for (uint32_t j = 0; j < resolution; ++j)
+		{
+			visit(0, i, j); visit(resolution - 1, i, j);
+			visit(i, 0, j); visit(i, resolution - 1, j);
+			visit(i, j, 0); visit(i, j, resolution - 1);
+		}
+	}
+
+	while (!stack.empty())
+	{
+		const uint32_t texel = stack.back();
+		stack.pop_back();
+		const uint32_t x = texel % resolution, y = (texel / resolution) % resolution, z = texel / (uint32_t)sliceSize;
+		if (x > 0) visit(x - 1, y, z);
+		if (x + 1 < resolution) visit(x + 1, y, z);
+		if (y > 0) visit(x, y - 1, z);
+		if (y + 1 < resolution) visit(x, y + 1, z);
+		if (z > 0) visit(x, y, z - 1);
+		if (z + 1 < resolution) visit(x, y, z + 1);
+	}
+
+	std::replace(distances.begin(), distances.end(), unknown, -band);
+
+	// Gradient from central differences, one sided on the grid border
+	std::vector<float> texels(distances.size() * 4);
+	auto getDistance = [&](int x, int y, int z) {
+		const int last = (int)resolution - 1;
+		return distances[glm::clamp(z, 0, last) * sliceSize + (size_t)glm::clamp(y, 0, last) * resolution + glm::clamp(x, 0, last)];
+	};
+
+	parallelFor(resolution, [&](uint32_t slice) {
+		const int z = (int)slice;
+		for (int y = 0; y < (int)resolution; ++y)
+		{
+			for (int x = 0; x < (int)resolution; ++x)
+			{
+				glm::vec3 gradient(getDistance(x + 1, y, z) - getDistance(x - 1, y, z), getDistance(x, y + 1, z) - getDistance(x, y - 1, z),
+					getDistance(x, y, z + 1) - getDistance(x, y, z - 1));
+				gradient = glm::dot(gradient, gradient) > 0.f ? glm::normalize(gradient) : glm::vec3(0.f);
+
+				const size_t texel = z * sliceSize + (size_t)y * resolution + x;
+				texels[texel * 4] = gradient.x;
+				texels[texel * 4 + 1] = gradient.y;
+				texels[texel * 4 + 2] = gradient.z;
+				texels[texel * 4 + 3] = distances[texel];
+			}
+		}
+	});
+
+	return texels;
+}
+
+bool HeadDistanceField::readCache(const std::string& cacheFileName, uint64_t inputHash, std::vector<float>& texels) const
+{
+	std::ifstream cachedFile(cacheFileName, std::ios::binary);
+	DistanceFieldHeader header{};
+	if (!cachedFile.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, distanceFieldMagic, sizeof(distanceFieldMagic)) != 0
+		|| header.version != distanceFieldVersion || header.resolution != resolution || header.inputHash != inputHash)
+		return false;
+
+	texels.resize((size_t)resolution * resolution * resolution * 4);
+	return bool(cachedFile.read((char*)texels.data(), texels.size() * sizeof(float)));
+}
+
+void HeadDistanceField::writeCache(const std::string& cacheFileName, uint64_t inputHash, const std::vector<float>& texels) const
+{
+	DistanceFieldHeader header{};
+	std::memcpy(header.magic, distanceFieldMagic, sizeof(distanceFieldMagic));
+	header.version = distanceFieldVersion;
+	header.resolution = resolution;
+	header.inputHash = inputHash;
+
+	std::ofstream cacheFile(cacheFileName, std::ios::binary);
+	if (!cacheFile)
+	{
+		std::cout << "Failed to open '" << cacheFileName << "' for writing!" << std::endl;
+		return;
+	}
+
+	cacheFile.write((const char*)&header, sizeof(header));
+	cacheFile.write((const char*)texels.data(), texels.size() * sizeof(float));
+}
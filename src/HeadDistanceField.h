@@ -0,0 +1,45 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class HeadMeshCache;
+class Shader;
+
+/*
+* Signed distance to the head mesh sampled on a cubic grid around it, in the same space as head mesh vertices.
+* Every RGBA16F texel of the 3D texture holds the distance gradient in RGB and signed distance in alpha, positive
+* outside the head, so collision is a single trilinear fetch whatever the mesh complexity.
+* Exact distances are computed on all hardware threads only in a narrow band around the triangles. Texels further
+* away are clamped to the band width, and their sign comes from a flood fill from the grid border.
+* Field is read from the cache file if it was baked from the same mesh with the same resolution, otherwise cache is rewritten.
+*/
+class HeadDistanceField {
+public:
+	HeadDistanceField(const HeadMeshCache& headMesh, const std::string& cacheFileName, uint32_t gridResolution = 64U);
+	~HeadDistanceField();
+	HeadDistanceField(const HeadDistanceField&) = delete;
+	HeadDistanceField& operator=(const HeadDistanceField&) = delete;
+	bool isValid() const { return texture != GL_NONE; }
+
+	// Binds field to texture unit and sets its sampler and grid bounds uniforms
+	void bind(const Shader& shader, GLuint textureUnit) const;
+
+private:
+	struct Triangle {
+		glm::vec3 positions[3];
+		glm::vec3 normals[3];
+	};
+
+	// Returns gradient and distance of every texel, x changes fastest
+	std::vector<float> bake(const std::vector<Triangle>& triangles) const;
+	bool readCache(const std::string& cacheFileName, uint64_t inputHash, std::vector<float>& texels) const;
+	void writeCache(const std::string& cacheFileName, uint64_t inputHash, const std::vector<float>& texels) const;
+	glm::vec3 getTexelCenter(uint32_t x, uint32_t y, uint32_t z) const;
+	GLuint texture = GL_NONE;
+	uint32_t resolution;
+	glm::vec3 minimum{ 0.f };
+	float size = 0.f;				// Edge length of the cubic grid
+};
@@ -0,0 +1,168 @@
+#include "HeadMeshCache.h"
+#include "OBJ_Loader.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+	const char meshCacheMagic[4] = { 'H', 'M', 'S', 'H' };
+
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~uint64_t(15);
+	}
+
+	// Scalp region of the head model in transformed coordinates
+	bool isScalpPoint(const glm::vec3& position)
+	{
+		return (position.y > -1.f && position.z < 0.f) || (position.y > -0.5f && position.z < 0.7f) || (position.y >= 0.5f && position.z < 1.7f);
+	}
+}
+
+HeadMeshCache::HeadMeshCache(const std::string& objFileName, const glm::mat4& transform)
+{
+	std::error_code error;
+	Header expectedHeader{};
+	std::memcpy(expectedHeader.magic, meshCacheMagic, sizeof(meshCacheMagic));
+	expectedHeader.version = currentVersion;
+	expectedHeader.sourceSize = std::filesystem::file_size(objFileName, error);
+	if (!error)
+		expectedHeader.sourceModificationTime = (int64_t)std::filesystem::last_write_time(objFileName, error).time_since_epoch().count();
+
+	if (error)
+	{
+		std::cout << "File '" << objFileName << "' doesn't exist" << std::endl;
+		return;
+	}
+
+	std::memcpy(expectedHeader.transform, glm::value_ptr(transform), sizeof(expectedHeader.transform));
+	const std::string cacheFileName = std::filesystem::path(objFileName).replace_extension(".meshcache").string();
+	if (map(cacheFileName, expectedHeader))
+		return;
+
+	if (build(objFileName, cacheFileName, expectedHeader))
+		map(cacheFileName, expectedHeader);
+}
+
+const float* HeadMeshCache::getVertexData() const
+{
+	return reinterpret_cast<const float*>(file->getData() + header->verticesOffset);
+}
+
+const float* HeadMeshCache::getTexCoords() const
+{
+	return reinterpret_cast<const float*>(file->getData() + header->texCoordsOffset);
+}
+
+const uint32_t* HeadMeshCache::getIndices() const
+{
+	return reinterpret_cast<const uint32_t*>(file->getData() + header->indicesOffset);
+}
+
+const uint32_t* HeadMeshCache::getScalpIndices() const
+{
+	return reinterpret_cast<const uint32_t*>(file->getData() + header->scalpIndicesOffset);
+}
+
+bool HeadMeshCache::map(const std::string& cacheFileName, const Header& expectedHeader)
+{
+	file = std::make_unique<MappedFile>(cacheFileName);
+	const Header* mappedHeader = reinterpret_cast<const Header*>(file->getData());
+	bool upToDate = file->isOpen() && file->getSize() >= sizeof(Header)
+		&& std::memcmp(mappedHeader->magic, expectedHeader.magic, sizeof(expectedHeader.magic)) == 0
+		&& mappedHeader->version == expectedHeader.version
+		&& mappedHeader->sourceSize == expectedHeader.sourceSize
+		&& mappedHeader->sourceModificationTime == expectedHeader.sourceModificationTime
+		&& std::memcmp(mappedHeader->transform, expectedHeader.transform, sizeof(expectedHeader.transform)) == 0;
+
+	if (upToDate)
+	{
+		upToDate = mappedHeader->verticesOffset + (uint64_t)mappedHeader->vertexCount * floatsPerVertex * sizeof(float) <= file->getSize()
+			&& mappedHeader->texCoordsOffset + (uint64_t)mappedHeader->vertexCount * 2 * sizeof(float) <= file->getSize()
+			&& mappedHeader->indicesOffset + (uint64_t)mappedHeader->indexCount * sizeof(uint32_t) <= file->getSize()
+			&& mappedHeader->scalpIndicesOffset + (uint64_t)mappedHeader->scalpIndexCount * sizeof(uint32_t) <= file->getSize();
+	}
+
+	if (!upToDate)
+	{
+		// Mapping has to be released before cache file is rewritten
+		file.reset();
+		return false;
+	}
+
+	header = mappedHeader;
+	return true;
+}
+
+bool HeadMeshCache::build(const std::string& objFileName, const std::string& cacheFileName, Header header)
+{
+	objl::Loader loader;
+	if (!loader.LoadFile(objFileName))
+	{
+		std::cout << "File '" << objFileName << "' couldn't be loaded" << std::endl;
+		return false;
+	}
+
+	const glm::mat4 transform = glm::make_mat4(header.transform);
+	const glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(transform));
+
+	std::vector<float> vertexData(loader.LoadedVertices.size() * floatsPerVertex);
+	std::vector<float> texCoords(loader.LoadedVertices.size() * 2);
+	for (size_t i = 0; i < loader.LoadedVertices.size(); ++i)
+	{
+		const auto& vertex = loader.LoadedVertices[i];
+		const glm::vec3 position = transform * glm::vec4(vertex.Position.X, vertex.Position.Y, vertex.Position.Z, 1.f);
+		const glm::vec3 normal = normalMatrix * glm::vec3(vertex.Normal.X, vertex.Normal.Y, vertex.Normal.Z);
+		std::memcpy(&vertexData[i * floatsPerVertex], &position.x, sizeof(glm::vec3));
+		std::memcpy(&vertexData[i * floatsPerVertex + 3], &normal.x, sizeof(glm::vec3));
+		texCoords[i * 2] = vertex.TextureCoordinate.X;
+		texCoords[i * 2 + 1] = vertex.TextureCoordinate.Y;
+	}
+
+	// Triangles with centroid on the scalp are the ones hair grows from
+	auto getPosition = [&vertexData](uint32_t index) {
+		return glm::vec3(vertexData[index * floatsPerVertex], vertexData[index * floatsPerVertex + 1], vertexData[index * floatsPerVertex + 2]);
+	};
+
+	std::vector<uint32_t> scalpIndices;
+	for (size_t i = 0; i + 2 < loader.LoadedIndices.size(); i += 3)
+	{
+		const uint32_t* triangle = &loader.LoadedIndices[i];
+		const glm::vec3 centroid = (getPosition(triangle[0]) + getPosition(triangle[1]) + getPosition(triangle[2])) / 3.f;
+		if (isScalpPoint(centroid))
+			scalpIndices.insert(scalpIndices.end(), triangle, triangle + 3);
+	}
+
+	header.vertexCount = (uint32_t)loader.LoadedVertices.size();
+	header.indexCount = (uint32_t)loader.LoadedIndices.size();
+	header.scalpIndexCount = (uint32_t)scalpIndices.size();
+	header.verticesOffset = alignOffset(sizeof(Header));
+	header.texCoordsOffset = alignOffset(header.verticesOffset + vertexData.size() * sizeof(float));
+	header.indicesOffset = alignOffset(header.texCoordsOffset + texCoords.size() * sizeof(float));
+	header.scalpIndicesOffset = alignOffset(header.indicesOffset + loader.LoadedIndices.size() * sizeof(uint32_t));
+
+	std::ofstream cacheFile(cacheFileName, std::ios::binary);
+	if (!cacheFile)
+	{
+		std::cout << "Failed to open '" << cacheFileName << "' for writing!" << std::endl;
+		return false;
+	}
+
+	const char padding[16] = {};
+	auto writeAligned = [&cacheFile, &padding](uint64_t offset, const void* data, size_t size) {
+		cacheFile.write(padding, offset - (uint64_t)cacheFile.tellp());
+		cacheFile.write((const char*)data, size);
+	};
+
+	cacheFile.write((const char*)&header, sizeof(Header));
+	writeAligned(header.verticesOffset, vertexData.data(), vertexData.size() * sizeof(float));
+	writeAligned(header.texCoordsOffset, texCoords.data(), texCoords.size() * sizeof(float));
+	writeAligned(header.indicesOffset, loader.LoadedIndices.data(), loader.LoadedIndices.size() * sizeof(uint32_t));
+	writeAligned(header.scalpIndicesOffset, scalpIndices.data(), scalpIndices.size() * sizeof(uint32_t));
+	return bool(cacheFile);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "MappedFile.h"
+#include <glm/mat4x4.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/*
+* Preprocessed head model stored next to its OBJ file.
+* Holds transformed interleaved positions and normals, texture coordinates, triangle indices and indices of scalp triangles,
+* so model can be uploaded from memory mapped file without parsing OBJ.
+* Cache is regenerated whenever OBJ file size, modification time or head transform change.
+*/
+class HeadMeshCache {
+public:
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceSize;
+		int64_t sourceModificationTime;
+		float transform[16];
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t scalpIndexCount;
+		uint32_t padding;
+		uint64_t verticesOffset;
+		uint64_t texCoordsOffset;
+		uint64_t indicesOffset;
+		uint64_t scalpIndicesOffset;
+	};
+
+	static constexpr uint32_t currentVersion = 3;
+	static constexpr uint32_t floatsPerVertex = 6;		// 3 position and 3 normal components
+
+	HeadMeshCache(const std::string& objFileName, const glm::mat4& transform);
+	bool isValid() const { return header != nullptr; }
+	const float* getVertexData() const;
+	uint32_t getVertexCount() const { return header->vertexCount; }
+	const float* getTexCoords() const;
+	const uint32_t* getIndices() const;
+	uint32_t getIndexCount() const { return header->indexCount; }
+	const uint32_t* getScalpIndices() const;
+	uint32_t getScalpIndexCount() const { return header->scalpIndexCount; }
+
+private:
+	bool map(const std::string& cacheFileName, const Header& expectedHeader);
+	static bool build(const std::string& objFileName, const std::string& cacheFileName, Header header);
+	std::unique_ptr<MappedFile> file;
+	const Header* header = nullptr;
+};
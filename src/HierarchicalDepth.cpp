@@ -0,0 +1,82 @@
+#include "HierarchicalDepth.h"
+#include <glm/glm.hpp>
+
+HierarchicalDepth::HierarchicalDepth() :
+	reduceShader("HierarchicalDepthComputeShader.glsl")
+{
+}
+
+HierarchicalDepth::~HierarchicalDepth()
+{
+	release();
+}
+
+void HierarchicalDepth::update()
+{
+	GLint targetFramebuffer = 0;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	resize(viewport[2], viewport[3]);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, targetFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer);
+	glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+		0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+
+	reduceShader.use();
+	reduceShader.setInt("depth", 0);
+	glBindTextureUnit(0, depthTexture);
+	const glm::ivec3 localWorkGroupCount = reduceShader.getLocalWorkGroupsCount();
+	for (GLint level = 0; level < levelCount; ++level)
+	{
+		const GLsizei levelWidth = glm::max(1, width >> level);
+		const GLsizei levelHeight = glm::max(1, height >> level);
+		reduceShader.setBool("firstLevel", level == 0);
+		glBindImageTexture(0, maximumDepthTexture, glm::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, maximumDepthTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		reduceShader.setGlobalWorkGroupCount((levelWidth + localWorkGroupCount.x - 1) / localWorkGroupCount.x,
+			(levelHeight + localWorkGroupCount.y - 1) / localWorkGroupCount.y);
+		reduceShader.dispatch();
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+}
+
+void HierarchicalDepth::bind(const Shader& shader, GLuint textureUnit) const
+{
+	shader.setInt("hierarchicalDepth", textureUnit);
+	shader.setInt("hierarchicalDepthLevels", levelCount);
+	glBindTextureUnit(textureUnit, maximumDepthTexture);
+}
+
+void HierarchicalDepth::resize(GLsizei viewportWidth, GLsizei viewportHeight)
+{
+	if (viewportWidth == width && viewportHeight == height)
+		return;
+
+	release();
+	width = viewportWidth;
+	height = viewportHeight;
+	levelCount = 1 + (GLint)glm::floor(glm::log2((float)glm::max(width, height)));
+
+	// Depth blits need the same format as default framebuffer
+	glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+	glTextureStorage2D(depthTexture, 1, GL_DEPTH24_STENCIL8, width, height);
+	glCreateFramebuffers(1, &resolveFramebuffer);
+	glNamedFramebufferTexture(resolveFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, depthTexture, 0);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &maximumDepthTexture);
+	glTextureStorage2D(maximumDepthTexture, levelCount, GL_R32F, width, height);
+	glTextureParameteri(maximumDepthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(maximumDepthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void HierarchicalDepth::release()
+{
+	glDeleteFramebuffers(1, &resolveFramebuffer);
+	glDeleteTextures(1, &depthTexture);
+	glDeleteTextures(1, &maximumDepthTexture);
+	resolveFramebuffer = depthTexture = maximumDepthTexture = GL_NONE;
+	width = height = levelCount = 0;
+}
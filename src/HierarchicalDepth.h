@@ -0,0 +1,34 @@
+#pragma once
+#include "ComputeShader.h"
+#include <glad/glad.h>
+
+/*
+* Mip chain of maximum depth of the bound framebuffer, used for occlusion culling.
+* Depth is resolved into a single sampled texture and copied to the first R32F level, every further level holds
+* the furthest depth of the texels it covers. Odd rows and columns are folded into the last texel of the next level,
+* so a texel of any level is never closer than the depth under it.
+*/
+class HierarchicalDepth {
+public:
+	HierarchicalDepth();
+	~HierarchicalDepth();
+	HierarchicalDepth(const HierarchicalDepth&) = delete;
+	HierarchicalDepth& operator=(const HierarchicalDepth&) = delete;
+
+	// Rebuilds the mip chain from depth of the bound draw framebuffer over the current viewport
+	void update();
+
+	// Binds mip chain to texture unit and sets its sampler and level count uniforms
+	void bind(const Shader& shader, GLuint textureUnit) const;
+
+private:
+	void resize(GLsizei viewportWidth, GLsizei viewportHeight);
+	void release();
+	ComputeShader reduceShader;
+	GLuint resolveFramebuffer = GL_NONE;
+	GLuint depthTexture = GL_NONE;
+	GLuint maximumDepthTexture = GL_NONE;
+	GLsizei width = 0;
+	GLsizei height = 0;
+	GLint levelCount = 0;
+};
@@ -0,0 +1,144 @@
+#include "MarschnerLut.h"
+#include "ParallelFor.h"
+#include "Shader.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	constexpr uint32_t crossSectionSamples = 64;
+
+	float gaussian(float width, float x)
+	{
+		return std::exp(-x * x / (2.f * width * width)) / (width * std::sqrt(glm::two_pi<float>()));
+	}
+
+	// Unpolarized dielectric Fresnel reflectance for cosine of incident angle
+	float fresnel(float eta, float cosIncident)
+	{
+		const float sinTransmittedSquared = (1.f - cosIncident * cosIncident) / (eta * eta);
+		if (sinTransmittedSquared >= 1.f)
+			return 1.f;
+
+		const float cosTransmitted = std::sqrt(1.f - sinTransmittedSquared);
+		const float perpendicular = (cosIncident - eta * cosTransmitted) / (cosIncident + eta * cosTransmitted);
+		const float parallel = (eta * cosIncident - cosTransmitted) / (eta * cosIncident + cosTransmitted);
+		return 0.5f * (perpendicular * perpendicular + parallel * parallel);
+	}
+
+	// Fills rows of RGBA texels on all hardware threads, rows are handed out one at a time
+	template<typename Function>
+	std::vector<float> computeRows(uint32_t size, Function computeTexel)
+	{
+		std::vector<float> texels((size_t)size * size * 4);
+		parallelFor(size, [&](uint32_t row) {
+			for (uint32_t column = 0; column < size; ++column)
+			{
+				const glm::vec4 texel = computeTexel((column + 0.5f) / size, (row + 0.5f) / size);
+				std::copy(&texel.x, &texel.x + 4, &texels[((size_t)row * size + column) * 4]);
+			}
+		});
+
+		return texels;
+	}
+}
+
+MarschnerLut::MarschnerLut(uint32_t lutSize, const Parameters& lutParameters) : size(std::max(lutSize, 2U)), parameters(lutParameters)
+{
+	longitudinalTexture = createTexture(computeLongitudinal());
+	azimuthalTexture = createTexture(computeAzimuthal());
+}
+
+MarschnerLut::~MarschnerLut()
+{
+	glDeleteTextures(1, &longitudinalTexture);
+	glDeleteTextures(1, &azimuthalTexture);
+}
+
+void MarschnerLut::bind(const Shader& shader, GLuint firstTextureUnit) const
+{
+	glBindTextureUnit(firstTextureUnit, longitudinalTexture);
+	glBindTextureUnit(firstTextureUnit + 1, azimuthalTexture);
+	shader.setInt("longitudinalLut", firstTextureUnit);
+	shader.setInt("azimuthalLut", firstTextureUnit + 1);
+}
+
+std::vector<float> MarschnerLut::computeLongitudinal() const
+{
+	const float shifts[3] = { parameters.longitudinalShift, -parameters.longitudinalShift / 2.f, -3.f * parameters.longitudinalShift / 2.f };
+	const float widths[3] = { parameters.longitudinalWidth, parameters.longitudinalWidth / 2.f, 2.f * parameters.longitudinalWidth };
+
+	// Texture coordinates map sines of light and eye inclination from [-1, 1]
+	return computeRows(size, [&](float u, float v) {
+		const float thetaI = std::asin(u * 2.f - 1.f);
+		const float thetaR = std::asin(v * 2.f - 1.f);
+		const float thetaH = 0.5f * (thetaI + thetaR);
+		const float cosThetaD = std::cos(0.5f * (thetaR - thetaI));
+		const float inverseCosSquared = 1.f / std::max(cosThetaD * cosThetaD, 0.01f);
+
+		glm::vec4 texel(0.f, 0.f, 0.f, cosThetaD);
+		for (int lobe = 0; lobe < 3; ++lobe)
+			texel[lobe] = gaussian(widths[lobe], thetaH - shifts[lobe]) * inverseCosSquared;
+
+		return texel;
+	});
+}
+
+std::vector<float> MarschnerLut::computeAzimuthal() const
+{
+	const float widths[3] = { parameters.longitudinalWidth, parameters.longitudinalWidth / 2.f, 2.f * parameters.longitudinalWidth };
+	const float pi = glm::pi<float>();
+
+	// Texture coordinates map cosine of azimuth difference from [-1, 1] and cosine of difference angle from [0, 1]
+	return computeRows(size, [&](float u, float v) {
+		const float phi = std::acos(u * 2.f - 1.f);
+		const float cosThetaD = std::max(v, 0.01f);
+		const float sinThetaD = std::sqrt(1.f - cosThetaD * cosThetaD);
+
+		// Bravais index for projection of the fiber cross section, and absorption along the inclined path
+		const float eta = parameters.refractiveIndex;
+		const float etaPrime = std::sqrt(eta * eta - sinThetaD * sinThetaD) / cosThetaD;
+		const float sinThetaT = sinThetaD / eta;
+		const float absorption = parameters.absorption / std::sqrt(1.f - sinThetaT * sinThetaT);
+
+		// N terms integrate attenuation of every path through the cross section against a Gaussian around its exit azimuth
+		glm::vec4 texel(0.f, 0.f, 0.f, 1.f);
+		for (uint32_t sample = 0; sample < crossSectionSamples; ++sample)
+		{
+			const float h = -1.f + (sample + 0.5f) * 2.f / crossSectionSamples;
+			const float gammaI = std::asin(h);
+			const float gammaT = std::asin(h / etaPrime);
+			const float reflectance = fresnel(etaPrime, std::cos(gammaI));
+			const float transmittance = std::exp(-2.f * absorption * (1.f + std::cos(2.f * gammaT)));
+
+			for (int p = 0; p < 3; ++p)
+			{
+				const float attenuation = p == 0 ? reflectance
+					: (1.f - reflectance) * (1.f - reflectance) * std::pow(reflectance, (float)(p - 1)) * std::pow(transmittance, (float)p);
+				const float exitPhi = 2.f * p * gammaT - 2.f * gammaI + p * pi;
+				const float difference = std::remainder(phi - exitPhi, 2.f * pi);
+				float distribution = 0.f;
+				for (int k = -1; k <= 1; ++k)
+					distribution += gaussian(widths[p], difference + 2.f * pi * k);
+
+				texel[p] += 0.5f * attenuation * distribution * (2.f / crossSectionSamples);
+			}
+		}
+
+		return texel;
+	});
+}
+
+GLuint MarschnerLut::createTexture(const std::vector<float>& texels) const
+{
+	GLuint texture = GL_NONE;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, 1, GL_RGBA16F, size, size);
+	glTextureSubImage2D(texture, 0, 0, 0, size, size, GL_RGBA, GL_FLOAT, texels.data());
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+class Shader;
+
+/*
+* Lookup textures of Marschner hair scattering with R, TT and TRT lobes, one lobe per color channel.
+* Longitudinal texture is indexed by sines of light and eye angles with the strand and holds M terms divided by
+* cos^2 of difference angle, which is stored in alpha. Azimuthal texture is indexed by cosine of azimuth difference
+* and that difference angle cosine and holds N terms integrated over the fiber cross section.
+* Both are computed on all hardware threads at construction, hair color is applied in the shader.
+*/
+class MarschnerLut {
+public:
+	struct Parameters {
+		float refractiveIndex = 1.55f;
+		float absorption = 0.2f;				// Scalar absorption coefficient of the fiber interior
+		float longitudinalShift = -0.13f;		// R lobe shift in radians, TT and TRT shifts derive from it
+		float longitudinalWidth = 0.13f;		// R lobe width in radians, TT and TRT widths derive from it
+	};
+
+	MarschnerLut(uint32_t lutSize = 128, const Parameters& lutParameters = Parameters{});
+	~MarschnerLut();
+	MarschnerLut(const MarschnerLut&) = delete;
+	MarschnerLut& operator=(const MarschnerLut&) = delete;
+
+	// Binds lookup textures to two consecutive texture units and sets sampler uniforms of HairFragmentShader
+	void bind(const Shader& shader, GLuint firstTextureUnit) const;
+
+private:
+	std::vector<float> computeLongitudinal() const;
+	std::vector<float> computeAzimuthal() const;
+	GLuint createTexture(const std::vector<float>& texels) const;
+	GLuint longitudinalTexture = GL_NONE;
+	GLuint azimuthalTexture = GL_NONE;
+	uint32_t size;
+	Parameters parameters;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Runs function for every index in range [0, count) on all hardware threads, indices are handed out one at a time
+template<typename Function>
+void parallelFor(uint32_t count, Function function)
+{
+	std::atomic<uint32_t> nextIndex{ 0 };
+	auto runOnThread = [&]() {
+		for (uint32_t index = nextIndex++; index < count; index = nextIndex++)
+			function(index);
+	};
+
+	const uint32_t threadCount = std::max(1U, std::min(std::thread::hardware_concurrency(), count));
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < threadCount; ++i)
+		threads.emplace_back(runOnThread);
+
+	runOnThread();
+	for (auto& thread : threads)
+		thread.join();
+}
@@ -0,0 +1,111 @@
+#include "ParticleSnapshot.h"
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	const char snapshotMagic[4] = { 'H', 'S', 'N', 'P' };
+	constexpr uint32_t snapshotVersion = 1;
+
+	ErrorMetrics computeErrorMetrics(const std::vector<float>& reference, const std::vector<float>& tested)
+	{
+		ErrorMetrics metrics;
+		const size_t particleCount = reference.size() / 3;
+		if (particleCount == 0)
+			return metrics;
+
+		double sum = 0.0, squaredSum = 0.0;
+		for (size_t i = 0; i < particleCount; ++i)
+		{
+			const double dx = (double)reference[i * 3] - tested[i * 3];
+			const double dy = (double)reference[i * 3 + 1] - tested[i * 3 + 1];
+			const double dz = (double)reference[i * 3 + 2] - tested[i * 3 + 2];
+			const double squaredError = dx * dx + dy * dy + dz * dz;
+			const double error = std::sqrt(squaredError);
+
+			// NaN in tested data has to show up as failure
+			if (error > metrics.maximum || std::isnan(error))
+			{
+				metrics.maximum = error;
+				metrics.worstParticle = (uint32_t)i;
+			}
+
+			sum += error;
+			squaredSum += squaredError;
+		}
+
+		metrics.mean = sum / particleCount;
+		metrics.rootMeanSquare = std::sqrt(squaredSum / particleCount);
+		return metrics;
+	}
+}
+
+bool ParticleSnapshot::save(const std::string& fileName) const
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Failed to open '" << fileName << "' for writing!" << std::endl;
+		return false;
+	}
+
+	file.write(snapshotMagic, sizeof(snapshotMagic));
+	file.write((const char*)&snapshotVersion, sizeof(snapshotVersion));
+	file.write((const char*)&strandCount, sizeof(strandCount));
+	file.write((const char*)&particlesPerStrand, sizeof(particlesPerStrand));
+	file.write((const char*)&stepCount, sizeof(stepCount));
+	file.write((const char*)positions.data(), positions.size() * sizeof(float));
+	file.write((const char*)velocities.data(), velocities.size() * sizeof(float));
+	return bool(file);
+}
+
+bool ParticleSnapshot::load(const std::string& fileName)
+{
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Snapshot '" << fileName << "' doesn't exist!" << std::endl;
+		return false;
+	}
+
+	char magic[4];
+	uint32_t version = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	if (!file || std::string(magic, 4) != std::string(snapshotMagic, 4) || version != snapshotVersion)
+	{
+		std::cout << "File '" << fileName << "' is not a valid snapshot!" << std::endl;
+		return false;
+	}
+
+	file.read((char*)&strandCount, sizeof(strandCount));
+	file.read((char*)&particlesPerStrand, sizeof(particlesPerStrand));
+	file.read((char*)&stepCount, sizeof(stepCount));
+
+	const size_t floatCount = (size_t)strandCount * particlesPerStrand * 3;
+	positions.resize(floatCount);
+	velocities.resize(floatCount);
+	file.read((char*)positions.data(), floatCount * sizeof(float));
+	file.read((char*)velocities.data(), floatCount * sizeof(float));
+	if (!file)
+	{
+		std::cout << "Snapshot '" << fileName << "' is truncated!" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+SnapshotComparison compareSnapshots(const ParticleSnapshot& reference, const ParticleSnapshot& tested)
+{
+	SnapshotComparison comparison;
+	comparison.layoutMatches = reference.strandCount == tested.strandCount && reference.particlesPerStrand == tested.particlesPerStrand
+		&& reference.positions.size() == tested.positions.size() && reference.velocities.size() == tested.velocities.size();
+
+	if (!comparison.layoutMatches)
+		return comparison;
+
+	comparison.positions = computeErrorMetrics(reference.positions, tested.positions);
+	comparison.velocities = computeErrorMetrics(reference.velocities, tested.velocities);
+	return comparison;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+* Positions and velocities of all simulated particles at some simulation step.
+* Both arrays hold 3 floats per particle, ordered strand by strand.
+*/
+struct ParticleSnapshot {
+	uint32_t strandCount = 0;
+	uint32_t particlesPerStrand = 0;
+	uint32_t stepCount = 0;
+	std::vector<float> positions;
+	std::vector<float> velocities;
+
+	bool save(const std::string& fileName) const;
+	bool load(const std::string& fileName);
+};
+
+struct ErrorMetrics {
+	double maximum = 0.0;
+	double mean = 0.0;
+	double rootMeanSquare = 0.0;
+	uint32_t worstParticle = 0;		// Index of the particle with maximum error
+};
+
+struct SnapshotComparison {
+	bool layoutMatches = false;		// False if strand or particle counts differ, metrics are not computed then
+	ErrorMetrics positions;
+	ErrorMetrics velocities;
+};
+
+// Per particle euclidean distance metrics between reference and tested snapshot
+SnapshotComparison compareSnapshots(const ParticleSnapshot& reference, const ParticleSnapshot& tested);
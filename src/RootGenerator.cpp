@@ -0,0 +1,327 @@
+#include "RootGenerator.h"
+#include "HeadMeshCache.h"
+#include "ParallelFor.h"
+#include <glm/glm.hpp>
+#include <stb_image.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace {
+	const char rootCacheMagic[4] = { 'H', 'R', 'T', 'S' };
+	constexpr uint32_t rootCacheVersion = 2;
+	constexpr uint32_t candidatesPerRoot = 8;
+	constexpr uint32_t maximumRejections = 32;
+	constexpr float minimumLengthScale = 0.1f;
+	constexpr float minimumSpacingDensity = 1.f / 16.f;
+	constexpr uint32_t candidatesPerChunk = 4096;
+	constexpr float radiusFalloff = 0.8f;
+	constexpr float maximumGridResolution = 128.f;
+
+	struct RootCacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t rootCount;
+		uint32_t seed;
+		uint64_t inputHash;
+	};
+
+	// FNV-1a
+	uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+
+		return hash;
+	}
+}
+
+bool ScalpMask::load(const std::string& fileName)
+{
+	// Gray, gray-alpha and RGB images are expanded to RGBA, rows are flipped like in 2D textures
+	int channelCount;
+	stbi_set_flip_vertically_on_load(true);
+	unsigned char* data = stbi_load(fileName.c_str(), &width, &height, &channelCount, 4);
+	if (!data || width <= 0 || height <= 0)
+	{
+		stbi_image_free(data);
+		width = height = 0;
+		pixels.clear();
+		return false;
+	}
+
+	pixels.assign(data, data + (size_t)width * height * 4);
+	stbi_image_free(data);
+	return true;
+}
+
+glm::vec2 ScalpMask::sample(const glm::vec2& texCoords) const
+{
+	if (pixels.empty())
+		return glm::vec2(1.f);
+
+	// Texture coordinates wrap around like with GL_REPEAT
+	const glm::vec2 texel = glm::fract(texCoords) * glm::vec2(width, height) - 0.5f;
+	const glm::ivec2 base = glm::ivec2(glm::floor(texel));
+	const glm::vec2 t = texel - glm::floor(texel);
+	auto fetch = [this](int x, int y) {
+		x = (x % width + width) % width;
+		y = (y % height + height) % height;
+		const uint8_t* pixel = &pixels[((size_t)y * width + x) * 4];
+		return glm::vec2(pixel[0], pixel[1]) / 255.f;
+	};
+
+	return glm::mix(glm::mix(fetch(base.x, base.y), fetch(base.x + 1, base.y), t.x),
+		glm::mix(fetch(base.x, base.y + 1), fetch(base.x + 1, base.y + 1), t.x), t.y);
+}
+
+RootGenerator::RootGenerator(const HeadMeshCache& headMesh, const ScalpMask* scalpMask)
+{
+	if (scalpMask && !scalpMask->pixels.empty())
+		mask = *scalpMask;
+
+	inputHash = hashBytes(0xcbf29ce484222325ULL, &candidatesPerRoot, sizeof(candidatesPerRoot));
+	inputHash = hashBytes(inputHash, &mask.width, sizeof(mask.width));
+	inputHash = hashBytes(inputHash, &mask.height, sizeof(mask.height));
+	inputHash = hashBytes(inputHash, mask.pixels.data(), mask.pixels.size());
+	if (!headMesh.isValid())
+		return;
+
+	// Painted mask decides where hair grows, otherwise hair grows on every scalp triangle
+	const bool masked = !mask.pixels.empty();
+	const uint32_t* indices = masked ? headMesh.getIndices() : headMesh.getScalpIndices();
+	const uint32_t indexCount = masked ? headMesh.getIndexCount() : headMesh.getScalpIndexCount();
+	const float* vertexData = headMesh.getVertexData();
+	const float* texCoords = headMesh.getTexCoords();
+	float totalWeight = 0.f;
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		Triangle triangle;
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			const float* vertex = vertexData + (size_t)indices[i + j] * HeadMeshCache::floatsPerVertex;
+			triangle.positions[j] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+			triangle.normals[j] = glm::vec3(vertex[3], vertex[4], vertex[5]);
+			triangle.texCoords[j] = glm::vec2(texCoords[(size_t)indices[i + j] * 2], texCoords[(size_t)indices[i + j] * 2 + 1]);
+		}
+
+		const glm::vec3 faceNormal = glm::cross(triangle.positions[1] - triangle.positions[0], triangle.positions[2] - triangle.positions[0]);
+		const float area = 0.5f * glm::length(faceNormal);
+
+		// Density bound used for rejection sampling inside the triangle
+		const float centroidDensity = mask.sample((triangle.texCoords[0] + triangle.texCoords[1] + triangle.texCoords[2]) / 3.f).x;
+		float densitySum = centroidDensity;
+		triangle.maximumDensity = centroidDensity;
+		for (const auto& vertexTexCoords : triangle.texCoords)
+		{
+			const float density = mask.sample(vertexTexCoords).x;
+			densitySum += density;
+			triangle.maximumDensity = std::max(triangle.maximumDensity, density);
+		}
+
+		if (!(area * triangle.maximumDensity > 0.f))
+			continue;
+
+		// Interpolated normals of a triangle with a missing vertex normal could vanish
+		for (auto& normal : triangle.normals)
+			normal = glm::length(normal) > 0.f ? glm::normalize(normal) : glm::normalize(faceNormal);
+
+		scalpArea += area;
+		weightedArea += area * densitySum / 4.f;
+		totalWeight += area * triangle.maximumDensity;
+		cumulativeWeights.push_back(totalWeight);
+		triangles.push_back(triangle);
+	}
+
+	inputHash = hashBytes(inputHash, triangles.data(), triangles.size() * sizeof(Triangle));
+}
+
+std::vector<HairRoot> RootGenerator::generate(uint32_t rootCount, uint32_t seed) const
+{
+	if (triangles.empty() || rootCount == 0)
+		return {};
+
+	return selectRoots(generateCandidates(rootCount * candidatesPerRoot, seed), rootCount);
+}
+
+std::vector<HairRoot> RootGenerator::generateCached(const std::string& cacheFileName, uint32_t rootCount, uint32_t seed) const
+{
+	std::vector<HairRoot> roots;
+	std::ifstream cachedFile(cacheFileName, std::ios::binary);
+	RootCacheHeader header{};
+	if (cachedFile.read((char*)&header, sizeof(header)) && std::memcmp(header.magic, rootCacheMagic, sizeof(rootCacheMagic)) == 0
+		&& header.version == rootCacheVersion && header.rootCount == rootCount && header.seed == seed && header.inputHash == inputHash)
+	{
+		roots.resize(rootCount);
+		if (cachedFile.read((char*)roots.data(), roots.size() * sizeof(HairRoot)))
+			return roots;
+	}
+
+	cachedFile.close();
+	roots = generate(rootCount, seed);
+	if (roots.size() != rootCount)
+		return roots;
+
+	std::memcpy(header.magic, rootCacheMagic, sizeof(rootCacheMagic));
+	header.version = rootCacheVersion;
+	header.rootCount = rootCount;
+	header.seed = seed;
+	header.inputHash = inputHash;
+
+	std::ofstream cacheFile(cacheFileName, std::ios::binary);
+	if (!cacheFile)
+	{
+		std::cout << "Failed to open '" << cacheFileName << "' for writing!" << std::endl;
+		return roots;
+	}
+
+	cacheFile.write((const char*)&header, sizeof(header));
+	cacheFile.write((const char*)roots.data(), roots.size() * sizeof(HairRoot));
+	return roots;
+}
+
+std::vector<RootGenerator::Candidate> RootGenerator::generateCandidates(uint32_t candidateCount, uint32_t seed) const
+{
+	std::vector<Candidate> candidates(candidateCount);
+	const float totalWeight = cumulativeWeights.back();
+	const uint32_t chunkCount = (candidateCount + candidatesPerChunk - 1) / candidatesPerChunk;
+
+	// Every chunk has its own random sequence, so result doesn't depend on number of threads
+	parallelFor(chunkCount, [&](uint32_t chunk) {
+		std::seed_seq seedSequence{ seed, chunk };
+		std::mt19937 random(seedSequence);
+		auto uniform = [&random]() { return (random() >> 8) * (1.f / 16777216.f); };
+
+		const uint32_t end = std::min(candidateCount, (chunk + 1) * candidatesPerChunk);
+		for (uint32_t i = chunk * candidatesPerChunk; i < end; ++i)
+		{
+			for (uint32_t attempt = 0; ; ++attempt)
+			{
+				// Triangle is picked proportionally to its area and density bound
+				const float weight = uniform() * totalWeight;
+				size_t t = std::upper_bound(cumulativeWeights.begin(), cumulativeWeights.end(), weight) - cumulativeWeights.begin();
+				const Triangle& triangle = triangles[std::min(t, triangles.size() - 1)];
+
+				const float s = std::sqrt(uniform());
+				const float r = uniform();
+				const glm::vec3 weights(1.f - s, s * (1.f - r), s * r);
+				const glm::vec2 texCoords = triangle.texCoords[0] * weights.x + triangle.texCoords[1] * weights.y + triangle.texCoords[2] * weights.z;
+				const glm::vec2 maskValue = mask.sample(texCoords);
+
+				Candidate& candidate = candidates[i];
+				candidate.root.position = triangle.positions[0] * weights.x + triangle.positions[1] * weights.y + triangle.positions[2] * weights.z;
+				candidate.root.normal = glm::normalize(triangle.normals[0] * weights.x + triangle.normals[1] * weights.y + triangle.normals[2] * weights.z);
+				candidate.root.lengthScale = std::max(maskValue.y, minimumLengthScale);
+				candidate.density = maskValue.x;
+
+				// Rejection keeps sample density proportional to the mask inside triangles, always accepted without mask
+				if (uniform() * triangle.maximumDensity <= maskValue.x || attempt == maximumRejections)
+					break;
+			}
+		}
+	});
+
+	return candidates;
+}
+
+std::vector<HairRoot> RootGenerator::selectRoots(const std::vector<Candidate>& candidates, uint32_t rootCount) const
+{
+	std::vector<HairRoot> roots;
+	roots.reserve(rootCount);
+
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+	std::vector<float> radiusScales(candidates.size());
+	float maximumRadiusScale = 0.f;
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		boundsMin = glm::min(boundsMin, candidates[i].root.position);
+		boundsMax = glm::max(boundsMax, candidates[i].root.position);
+
+		// Spacing between roots is inversely proportional to square root of density
+		radiusScales[i] = 1.f / std::sqrt(std::max(candidates[i].density, minimumSpacingDensity));
+		maximumRadiusScale = std::max(maximumRadiusScale, radiusScales[i]);
+	}
+
+	const glm::vec3 extent = boundsMax - boundsMin;
+	const float largestExtent = std::max(extent.x, std::max(extent.y, extent.z));
+
+	// Distance between roots of unit density if they were packed hexagonally over the scalp
+	const float packingRadius = std::sqrt(weightedArea / (rootCount * 0.866f));
+	std::vector<uint8_t> accepted(candidates.size(), 0);
+	std::vector<int32_t> firstInCell;
+	std::vector<int32_t> nextInCell(rootCount, -1);
+
+	for (float radius = 2.f * packingRadius; roots.size() < rootCount; radius *= radiusFalloff)
+	{
+		// Last pass accepts all remaining candidates in order
+		if (radius < 0.1f * packingRadius)
+			radius = 0.f;
+
+		// Cells are at least as large as the largest radius, so only neighbouring cells have to be checked
+		const float cellSize = std::max(radius * maximumRadiusScale, largestExtent / maximumGridResolution);
+		const glm::ivec3 resolution = glm::ivec3(extent / cellSize) + 1;
+		firstInCell.assign((size_t)resolution.x * resolution.y * resolution.z, -1);
+
+		auto getCell = [&](const glm::vec3& position) {
+			return glm::clamp(glm::ivec3((position - boundsMin) / cellSize), glm::ivec3(0), resolution - 1);
+		};
+
+		auto getCellIndex = [&resolution](const glm::ivec3& cell) {
+			return ((size_t)cell.z * resolution.y + cell.y) * resolution.x + cell.x;
+		};
+
+		auto insertRoot = [&](uint32_t rootIndex) {
+			const size_t cellIndex = getCellIndex(getCell(roots[rootIndex].position));
+			nextInCell[rootIndex] = firstInCell[cellIndex];
+			firstInCell[cellIndex] = (int32_t)rootIndex;
+		};
+
+		for (uint32_t i = 0; i < roots.size(); ++i)
+			insertRoot(i);
+
+		for (size_t i = 0; i < candidates.size() && roots.size() < rootCount; ++i)
+		{
+			if (accepted[i])
+				continue;
+
+			const glm::vec3& position = candidates[i].root.position;
+			const float candidateRadius = radius * radiusScales[i];
+			const glm::ivec3 cell = getCell(position);
+			const glm::ivec3 first = glm::max(cell - 1, glm::ivec3(0));
+			const glm::ivec3 last = glm::min(cell + 1, resolution - 1);
+			bool farEnough = true;
+			for (int z = first.z; z <= last.z && farEnough && radius > 0.f; ++z)
+			{
+				for (int y = first.y; y <= last.y && farEnough; ++y)
+				{
+					for (int x = first.x; x <= last.x && farEnough; ++x)
+					{
+						for (int32_t root = firstInCell[getCellIndex(glm::ivec3(x, y, z))]; root != -1 && farEnough; root = nextInCell[root])
+						{
+							const glm::vec3 difference = roots[root].position - position;
+							farEnough = glm::dot(difference, difference) >= candidateRadius * candidateRadius;
+						}
+					}
+				}
+			}
+
+			if (farEnough)
+			{
+				accepted[i] = 1;
+				roots.push_back(candidates[i].root);
+				insertRoot((uint32_t)roots.size() - 1);
+			}
+		}
+
+		if (radius == 0.f)
+			break;
+	}
+
+	return roots;
+}
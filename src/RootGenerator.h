@@ -0,0 +1,70 @@
+#pragma once
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class HeadMeshCache;
+
+struct HairRoot {
+	glm::vec3 position;
+	glm::vec3 normal;
+	float lengthScale;
+};
+
+/*
+* Root distribution painted over head texture coordinates.
+* Red channel scales root density and green channel scales strand length.
+*/
+struct ScalpMask {
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> pixels;		// RGBA, bottom row first
+
+	// Decodes any image as 8-bit RGBA on CPU, returns false and stays empty if it can't be loaded
+	bool load(const std::string& fileName);
+
+	// Bilinearly filtered density and length in range [0, 1]
+	glm::vec2 sample(const glm::vec2& texCoords) const;
+};
+
+/*
+* Places hair roots over scalp triangles of the head mesh.
+* Candidates are sampled proportionally to triangle area on all hardware threads and then thinned with a Poisson-disk
+* test whose radius shrinks every pass. Roots are ordered by acceptance, so every prefix of the result is evenly
+* distributed and strand count can change without placing roots again.
+* With a mask, all head triangles are sampled proportionally to painted density and Poisson-disk radius shrinks where
+* density is higher. Without it, scalp triangles are covered uniformly with full length strands.
+*/
+class RootGenerator {
+public:
+	RootGenerator(const HeadMeshCache& headMesh, const ScalpMask* mask = nullptr);
+	std::vector<HairRoot> generate(uint32_t rootCount, uint32_t seed) const;
+
+	// Result is read from cache file if it was generated from the same mesh, mask, count and seed, otherwise cache is rewritten
+	std::vector<HairRoot> generateCached(const std::string& cacheFileName, uint32_t rootCount, uint32_t seed) const;
+	float getScalpArea() const { return scalpArea; }
+
+private:
+	struct Triangle {
+		glm::vec3 positions[3];
+		glm::vec3 normals[3];
+		glm::vec2 texCoords[3];
+		float maximumDensity;
+	};
+
+	struct Candidate {
+		HairRoot root;
+		float density;
+	};
+
+	std::vector<Candidate> generateCandidates(uint32_t candidateCount, uint32_t seed) const;
+	std::vector<HairRoot> selectRoots(const std::vector<Candidate>& candidates, uint32_t rootCount) const;
+	ScalpMask mask;
+	std::vector<Triangle> triangles;
+	std::vector<float> cumulativeWeights;
+	float scalpArea = 0.f;
+	float weightedArea = 0.f;
+	uint64_t inputHash = 0;
+};
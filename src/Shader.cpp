@@ -118,6 +118,11 @@ void Shader::setUintArray(const std::string& name, int count, const uint32_t val
 	glUniform1uiv(getUniformLocation(name), count, value);
 }
 
+void Shader::setUvec3(const std::string& name, const glm::uvec3& value) const
+{
+	glUniform3ui(getUniformLocation(name), value.x, value.y, value.z);
+}
+
 void Shader::setFloat(const std::string& name, const float value) const
 {
 	glUniform1f(getUniformLocation(name), value);
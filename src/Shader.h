@@ -13,6 +13,7 @@ public:
 	void setIntArray(const std::string& name, GLsizei count, const GLint value[]) const;
 	void setUint(const std::string& name, const uint32_t value) const;
 	void setUintArray(const std::string& name, int count, const uint32_t value[]) const;
+	void setUvec3(const std::string& name, const glm::uvec3& value) const;
 	void setBool(const std::string& name, const bool value) const;
 	void setBoolArray(const std::string& name, GLsizei count, bool values[]) const;
 	void setFloat(const std::string& name, const float value) const;
@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth prepass only writes depth, color writes are disabled
+void main()
+{
+}
@@ -1,11 +1,26 @@
-#version 460 core
+#version 450 core
 #define MAX_VERTICES_PER_STRAND 50
 #define FTL 0
 #define FILL_VOLUMES 1
 #define COLLISIONS 2
+#define BUILD_ACTIVE_LIST 3
+
+#define FOLLOW_THE_LEADER 0
+#define XPBD 1
 
-#define ELLIPSOID_COUNT 7
 #define VOLUME_UPPER_LIMIT 10
+#define PARTICLE_DENSITY 1000.0		// Voxel density of a single particle splatted at a voxel vertex
+
+#define PLANE 0
+#define SPHERE 1
+#define CAPSULE 2
+#define BOX 3
+#define ELLIPSOID 4
+#define HEAD_DISTANCE_FIELD 0xFFFFFFFFu		// Collider index of the head distance field of the instance
+#define ELLIPSOIDS_PER_INSTANCE 7		// Head ellipsoids of every hair system instance at the start of the collider list
+#define SWEEP_MAX_STEPS 64
+#define SWEEP_TOLERANCE 0.001
+#define MAX_SWEPT_COLLIDERS 16		// Colliders remembered per particle so ones spanning several cells are resolved once
 
 layout (local_size_x = 128) in;
 
@@ -17,57 +32,178 @@ layout (std430, binding = 1) buffer HairVelocity {
 	float velocities[][3];
 };
 
+// One voxel grid per instance, centered at instance origin
 layout (std430, binding = 2) buffer volumeDensity {
-	int volumeDensities[11][11][11];
+	int volumeDensities[][11][11][11];
 };
 
 layout (std430, binding = 3) buffer volumeVelocity {
-	int volumeVelocities[11][11][11][3];
+	int volumeVelocities[][11][11][11][3];
 };
 
-struct HairData {
-	uint particlesPerStrand;
-	uint strandCount;
-	float particleMass;
+// Voxel field of the rebuild before the latest one, blended with it while the field isn't rebuilt every step
+layout (std430, binding = 13) readonly buffer previousVolumeDensity {
+	int previousVolumeDensities[][11][11][11];
+};
+
+layout (std430, binding = 14) readonly buffer previousVolumeVelocity {
+	int previousVolumeVelocities[][11][11][11][3];
+};
+
+struct StrandAttributes {
+	vec4 color;
 	float segmentLength;
+	float curlScale;
+	float particleMass;
+	float stiffness;
+};
+
+layout (std430, binding = 4) readonly buffer StrandAttributeBuffer {
+	StrandAttributes strandAttributes[];
 };
 
-struct Force {
+// Transform and forces of every simulated hair
+struct HairInstance {
+	mat4 model;
+	mat4 inverseModel;
+	mat4 previousModel;		// Transform of the previous step, head collision is swept between the two
+	mat4 previousInverseModel;
 	vec4 wind;
 	float gravity;
+	float frictionCoefficient;
+	float velocityDampingCoefficient;
+	float curlRadius;
+	float volumeRepulsion;		// Strength of the push of particles from dense towards sparse voxels
+};
+
+layout (std430, binding = 5) readonly buffer HairInstanceBuffer {
+	HairInstance instances[];
+};
+
+// Written by culling pass of hair systems, 0 marks instances outside of the view
+layout (std430, binding = 7) readonly buffer InstanceVisibilityBuffer {
+	uint instanceVisibility[];
 };
 
+// Steps every strand has been nearly still for, strands still for sleepSteps are asleep and not simulated
+layout (std430, binding = 10) buffer StrandRestBuffer {
+	uint strandRestSteps[];
+};
+
+layout (std430, binding = 11) buffer ActiveStrandBuffer {
+	uint activeStrands[];
+};
+
+// Indirect dispatch arguments of FTL stage followed by number of active strands
+layout (std430, binding = 12) buffer ActiveDispatchBuffer {
+	uint activeGroupCountX;
+	uint activeGroupCountY;
+	uint activeGroupCountZ;
+	uint activeStrandCount;
+};
+
+// Collision primitive in its own space under world transform, see ColliderSet
+struct Collider {
+	mat4 transform;
+	mat4 inverseTransform;
+	mat4 previousTransform;		// Transform of the previous step, particles are swept through the motion between the two
+	mat4 previousInverseTransform;
+	vec4 shape;
+	uint type;
+};
+
+layout (std430, binding = 15) readonly buffer ColliderBuffer {
+	Collider colliders[];
+};
+
+// Offset and count of collider indices of every broadphase grid cell
+layout (std430, binding = 16) readonly buffer ColliderCellBuffer {
+	uvec2 colliderCells[];
+};
+
+// Planes tested by every particle come first, followed by collider indices of all cells
+layout (std430, binding = 17) readonly buffer ColliderIndexBuffer {
+	uint colliderIndices[];
+};
+
+// Styled pose of every particle in hair local space, see Hair::getRestShapeBuffer
+layout (std430, binding = 18) readonly buffer RestShapeBuffer {
+	float restPositions[][3];
+};
 
-uniform mat4 ellipsoids[ELLIPSOID_COUNT];
-uniform float ellipsoidRadius;
-uniform mat4 model;
-uniform float curlRadius = 0.05f;
+// Transform of every hair system instance at its last step simulated at the culled rate
+struct CulledTransform {
+	mat4 previousModel;
+	mat4 previousInverseModel;
+};
+
+layout (std430, binding = 19) readonly buffer CulledTransformBuffer {
+	CulledTransform culledTransforms[];
+};
+
+// Strand count is summed over all instances, every instance has strandsPerInstance strands
+struct HairData {
+	uint particlesPerStrand;
+	uint strandCount;
+	uint strandsPerInstance;
+};
+
+uniform uint colliderPlaneCount;
+uniform vec3 colliderGridMinimum;
+uniform float colliderCellSize;
+uniform uvec3 colliderGridResolution;		// Zero without any collider in the grid
+
+// Signed distance to the head and its gradient in hair local space, replaces ellipsoids when enabled
+uniform bool distanceFieldCollision = false;
+uniform sampler3D headDistanceField;
+uniform vec3 distanceFieldMinimum;
+uniform float distanceFieldSize;
 uniform uint state;
-uniform Force force;
 uniform HairData hairData;
 uniform float deltaTime;
 uniform float runningTime;
-uniform float velocityDampingCoefficient = 0.90;
-uniform float frictionCoefficient = 0.0;
-
-vec3 followTheLeader(in vec3 leaderParticlePosition, in vec3 proposedParticlePosition, out vec3 positionCorrectionVector) 
+uniform bool skipCulledInstances = false;
+uniform uint culledStepCount = 1;		// Steps culled instances advance by when they aren't skipped
+uniform uint headEllipsoidColliderCount = 0;		// Colliders that are head ellipsoids of hair system instances
+uniform float volumeBlend = 1.0;		// Weight of the latest voxel field, the rest comes from the previous one
+uniform bool sleeping = false;
+uniform bool wakeStrands;
+uniform uint sleepSteps;
+uniform float sleepEnergy;		// Mean kinetic energy per particle under which a strand is still
+uniform uint solver = FOLLOW_THE_LEADER;
+uniform uint solverIterations = 4;
+uniform float stretchCompliance;		// Inverse stiffness of XPBD constraints
+uniform float bendingCompliance;
+uniform float bendingStiffness;		// Added to stiffness of every strand
+uniform float shapeStiffness;		// Pull of particles towards their rest positions on the head
+
+// Attributes of the strand simulated by this invocation and its hair instance
+StrandAttributes strand;
+uint strandOffset;		// Index of the root particle of the strand
+uint instanceIndex;
+vec3 instanceOrigin;
+bool culledStep;		// Instance is culled and advances by culledStepCount steps at once
+float stepTime;		// Time the instance advances by in this step
+
+vec3 followTheLeader(in vec3 leaderParticlePosition, in vec3 proposedParticlePosition, in float segmentLength, out vec3 positionCorrectionVector) 
 {
 	const vec3 direction = normalize(proposedParticlePosition - leaderParticlePosition);
-	vec3 fixedPosition = leaderParticlePosition + (direction * hairData.segmentLength);
+	vec3 fixedPosition = leaderParticlePosition + (direction * segmentLength);
 	positionCorrectionVector = fixedPosition - proposedParticlePosition;
 	return fixedPosition;
 }
 
 vec3 generateGravityForce() 
 {
-	return hairData.particleMass * vec3(0.0, force.gravity, 0.0);
+	return strand.particleMass * vec3(0.0, instances[instanceIndex].gravity, 0.0);
 }
 
 vec3 generateWindForce(in vec3 particlePosition) 
 {
-	if (vec3(force.wind) == vec3(0.0)) 
+	const vec4 wind = instances[instanceIndex].wind;
+	if (vec3(wind) == vec3(0.0)) 
 	{
-		return force.wind.w * normalize(vec3(
+		return wind.w * normalize(vec3(
 					sin(runningTime + particlePosition.z * 20.0),
                     cos(deltaTime * particlePosition.y * 5.0),
                     sin(runningTime + particlePosition.x * 30.0)
@@ -76,37 +212,95 @@ vec3 generateWindForce(in vec3 particlePosition)
 	} 
 	else
 	{
-		return normalize(vec3(force.wind)) * force.wind.w;
+		return normalize(vec3(wind)) * wind.w;
 	}
 }
 
 vec3 integrateExplicitEuler(in vec3 forces, in vec3 particlePosition, in vec3 particleVelocity)
 {
-	const vec3 acceleration = forces / hairData.particleMass;
-	return (particlePosition + (particleVelocity * deltaTime) + (acceleration * deltaTime * deltaTime));
+	const vec3 acceleration = forces / strand.particleMass;
+	return (particlePosition + (particleVelocity * stepTime) + (acceleration * stepTime * stepTime));
 }
 
 vec3 integrateHeun(in vec3 forces, in vec3 particlePosition, in vec3 particleVelocity) 
 {
-	const vec3 acceleration = forces / hairData.particleMass;
+	const vec3 acceleration = forces / strand.particleMass;
 
-	const vec3 firstVelocity = particleVelocity + deltaTime * acceleration;
-	const vec3 firstPosition = particlePosition + deltaTime * firstVelocity;
+	const vec3 firstVelocity = particleVelocity + stepTime * acceleration;
+	const vec3 firstPosition = particlePosition + stepTime * firstVelocity;
 
-	const vec3 secondVelocity = firstVelocity + deltaTime * (generateGravityForce() + generateWindForce(firstPosition) / hairData.particleMass);
+	const vec3 secondVelocity = firstVelocity + stepTime * (generateGravityForce() + generateWindForce(firstPosition) / strand.particleMass);
 
-	return (particlePosition + deltaTime * ((firstVelocity + secondVelocity) / 2));
+	return (particlePosition + stepTime * ((firstVelocity + secondVelocity) / 2));
 }
 
 vec3 updateVelocity(in vec3 oldPosition, in vec3 newPosition) 
 {
-	return ((newPosition - oldPosition) / deltaTime);
+	return ((newPosition - oldPosition) / stepTime);
+}
+
+vec3 getVoxelVelocity(in ivec3 coords)
+{
+	vec3 velocity = vec3(volumeVelocities[instanceIndex][coords.x][coords.y][coords.z][0],
+		volumeVelocities[instanceIndex][coords.x][coords.y][coords.z][1],
+		volumeVelocities[instanceIndex][coords.x][coords.y][coords.z][2]);
+	if (volumeDensities[instanceIndex][coords.x][coords.y][coords.z] != 0)
+		velocity /= float(volumeDensities[instanceIndex][coords.x][coords.y][coords.z]);
+
+	if (volumeBlend >= 1.0)
+		return velocity;
+
+	vec3 previousVelocity = vec3(previousVolumeVelocities[instanceIndex][coords.x][coords.y][coords.z][0],
+		previousVolumeVelocities[instanceIndex][coords.x][coords.y][coords.z][1],
+		previousVolumeVelocities[instanceIndex][coords.x][coords.y][coords.z][2]);
+	if (previousVolumeDensities[instanceIndex][coords.x][coords.y][coords.z] != 0)
+		previousVelocity /= float(previousVolumeDensities[instanceIndex][coords.x][coords.y][coords.z]);
+
+	return mix(previousVelocity, velocity, volumeBlend);
+}
+
+float getVoxelDensity(in ivec3 coords)
+{
+	const float density = float(volumeDensities[instanceIndex][coords.x][coords.y][coords.z]);
+	if (volumeBlend >= 1.0)
+		return density;
+
+	return mix(float(previousVolumeDensities[instanceIndex][coords.x][coords.y][coords.z]), density, volumeBlend);
+}
+
+// Trilinearly interpolated hair density in w and its gradient in xyz, from the grid filled for friction
+vec4 interpolateDensity(in vec3 particlePosition)
+{
+	particlePosition += (VOLUME_UPPER_LIMIT / 2) - instanceOrigin;
+	const ivec3 flooredCoords = clamp(ivec3(floor(particlePosition)), ivec3(0), ivec3(VOLUME_UPPER_LIMIT - 1));
+	const vec3 t = clamp(particlePosition - flooredCoords, vec3(0.0), vec3(1.0));
+
+	vec4 density = vec4(0.0);
+	for (uint i = 0; i < 2; ++i)
+	{
+		for (uint j = 0; j < 2; ++j)
+		{
+			for (uint k = 0; k < 2; ++k)
+			{
+				// Weights along every axis and their derivatives, which are -1 for the lower vertex and 1 for the upper one
+				const vec3 weights = mix(1.0 - t, t, vec3(i, j, k));
+				const vec3 derivatives = vec3(i, j, k) * 2.0 - 1.0;
+				const float voxelDensity = getVoxelDensity(flooredCoords + ivec3(i, j, k));
+				density.x += voxelDensity * derivatives.x * weights.y * weights.z;
+				density.y += voxelDensity * weights.x * derivatives.y * weights.z;
+				density.z += voxelDensity * weights.x * weights.y * derivatives.z;
+				density.w += voxelDensity * weights.x * weights.y * weights.z;
+			}
+		}
+	}
+
+	return density;
 }
 
 // Very useful article: https://www.scratchapixel.com/lessons/mathematics-physics-for-computer-graphics/interpolation/introduction
 vec3 interpolateVelocity(in vec3 particlePosition)
 {
-	particlePosition += (VOLUME_UPPER_LIMIT / 2);
+	particlePosition += (VOLUME_UPPER_LIMIT / 2) - instanceOrigin;
 	ivec3 flooredCoords = ivec3(floor(particlePosition));
 
 	// Upper limit of the regular voxel grid, flooring to 9
@@ -121,11 +315,7 @@ vec3 interpolateVelocity(in vec3 particlePosition)
 		{
 			for (uint k = 0; k < 2; ++k)
 			{
-				voxelVertexVelocities[i][j][k].x = volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][0];
-				voxelVertexVelocities[i][j][k].y = volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][1];
-				voxelVertexVelocities[i][j][k].z = volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][2];
-				if (volumeDensities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k] != 0)
-					voxelVertexVelocities[i][j][k] /= float(volumeDensities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k]);
+				voxelVertexVelocities[i][j][k] = getVoxelVelocity(flooredCoords + ivec3(i, j, k));
 			}
 		}
 	}
@@ -153,18 +343,60 @@ vec3 interpolateVelocity(in vec3 particlePosition)
 
 vec3 correctFtlVelocity(in vec3 currentParticleVelocity, in vec3 nextParticleCorrectionVector) 
 {
-	const vec3 correctedVelocity = currentParticleVelocity + velocityDampingCoefficient * (-nextParticleCorrectionVector / deltaTime);
+	const vec3 correctedVelocity = currentParticleVelocity + instances[instanceIndex].velocityDampingCoefficient * (-nextParticleCorrectionVector / stepTime);
 	return correctedVelocity;
 }
 
+// Selects instance of the particle simulated by this invocation
+/*
+* Culled instances skip steps in between, so when they run they advance by all the skipped steps and are swept from
+* their transform at the last step they were simulated.
+*/
+void loadInstanceStep()
+{
+	culledStep = culledStepCount > 1 && instanceVisibility[instanceIndex] == 0;
+	stepTime = culledStep ? deltaTime * culledStepCount : deltaTime;
+}
+
+void loadParticleInstance()
+{
+	instanceIndex = gl_GlobalInvocationID.x / (hairData.strandsPerInstance * hairData.particlesPerStrand);
+	instanceOrigin = vec3(instances[instanceIndex].model[3]);
+	loadInstanceStep();
+}
+
+// Culled instances are simulated at a lower rate and skip steps in between
+bool isInstanceSkipped()
+{
+	return skipCulledInstances && instanceVisibility[instanceIndex] == 0;
+}
+
 void addHairFriction()
 {
-	if (gl_GlobalInvocationID.x > hairData.strandCount * hairData.particlesPerStrand)
+	if (gl_GlobalInvocationID.x >= hairData.strandCount * hairData.particlesPerStrand)
+		return;
+
+	loadParticleInstance();
+	if (isInstanceSkipped() || (sleeping && strandRestSteps[gl_GlobalInvocationID.x / hairData.particlesPerStrand] >= sleepSteps))
 		return;
 
+	const float frictionCoefficient = instances[instanceIndex].frictionCoefficient;
 	vec3 particlePosition = vec3(positions[gl_GlobalInvocationID.x][0], positions[gl_GlobalInvocationID.x][1], positions[gl_GlobalInvocationID.x][2]); 
 	vec3 particleVelocity = vec3(velocities[gl_GlobalInvocationID.x][0], velocities[gl_GlobalInvocationID.x][1], velocities[gl_GlobalInvocationID.x][2]); 
 	particleVelocity = (1.0 - frictionCoefficient) * particleVelocity + frictionCoefficient * interpolateVelocity(particlePosition);
+
+	/*
+	* Hair pressure proportional to density pushes particles down the density gradient, which keeps hair volume.
+	* Dividing by density makes the push independent of strand count, single particles in sparse voxels are never pushed
+	* harder than in a voxel of one particle.
+	*/
+	const float volumeRepulsion = instances[instanceIndex].volumeRepulsion;
+	if (volumeRepulsion > 0.0)
+	{
+		const vec4 density = interpolateDensity(particlePosition);
+		particleVelocity -= stepTime * volumeRepulsion * density.xyz / max(density.w, PARTICLE_DENSITY);
+	}
+
 	velocities[gl_GlobalInvocationID.x][0] = particleVelocity.x;
 	velocities[gl_GlobalInvocationID.x][1] = particleVelocity.y;
 	velocities[gl_GlobalInvocationID.x][2] = particleVelocity.z;
@@ -172,11 +404,15 @@ void addHairFriction()
 
 void fillVolumes() 
 {
-	if (gl_GlobalInvocationID.x > hairData.strandCount * hairData.particlesPerStrand)
+	if (gl_GlobalInvocationID.x >= hairData.strandCount * hairData.particlesPerStrand)
+		return;
+
+	// Adding 5 to linearly map [-5,5] range around instance origin to [0,10] range
+	loadParticleInstance();
+	if (isInstanceSkipped())
 		return;
 
-	// Adding 5 to linearly map [-5,5] range to [0,10] range
-	const vec3 particlePosition = vec3(positions[gl_GlobalInvocationID.x][0], positions[gl_GlobalInvocationID.x][1], positions[gl_GlobalInvocationID.x][2]) + (VOLUME_UPPER_LIMIT / 2); 
+	const vec3 particlePosition = vec3(positions[gl_GlobalInvocationID.x][0], positions[gl_GlobalInvocationID.x][1], positions[gl_GlobalInvocationID.x][2]) + (VOLUME_UPPER_LIMIT / 2) - instanceOrigin; 
 	const vec3 particleVelocity = vec3(velocities[gl_GlobalInvocationID.x][0], velocities[gl_GlobalInvocationID.x][1], velocities[gl_GlobalInvocationID.x][2]); 
 	ivec3 flooredCoords = ivec3(floor(particlePosition));
 	if (flooredCoords.x >= VOLUME_UPPER_LIMIT) flooredCoords.x = VOLUME_UPPER_LIMIT - 1;
@@ -191,54 +427,353 @@ void fillVolumes()
 			{
 				float densityW = (1.0 - abs(particlePosition.x - flooredCoords.x - i)) * (1.0 - abs(particlePosition.y - flooredCoords.y - j)) * (1.0 - abs(particlePosition.z - flooredCoords.z - k)) * 1000.f;
 				int densityWeight = int(densityW);
-				atomicAdd(volumeDensities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k], densityWeight);
-				atomicAdd(volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][0], int(densityWeight * particleVelocity.x));
-				atomicAdd(volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][1], int(densityWeight * particleVelocity.y));
-				atomicAdd(volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][2], int(densityWeight * particleVelocity.z));
+				atomicAdd(volumeDensities[instanceIndex][flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k], densityWeight);
+				atomicAdd(volumeVelocities[instanceIndex][flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][0], int(densityWeight * particleVelocity.x));
+				atomicAdd(volumeVelocities[instanceIndex][flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][1], int(densityWeight * particleVelocity.y));
+				atomicAdd(volumeVelocities[instanceIndex][flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][2], int(densityWeight * particleVelocity.z));
 			}
 		}
 	}
 }
 
-void resolveBodyCollision(inout vec3 particlePosition) 
+vec3 normalizeOrUp(in vec3 direction)
+{
+	return dot(direction, direction) > 0.0 ? normalize(direction) : vec3(0.0, 1.0, 0.0);
+}
+
+// Signed distance and outward normal in space of the collider, or in head space for HEAD_DISTANCE_FIELD
+float getColliderDistance(in uint colliderIndex, in vec3 position, out vec3 normal)
 {
-	for (uint i = 0; i < ELLIPSOID_COUNT; ++i)
+	if (colliderIndex == HEAD_DISTANCE_FIELD)
 	{
-		vec3 transformedPosition = vec3(inverse(ellipsoids[i]) * vec4(particlePosition, 1.f));
-		if (length(transformedPosition) < ellipsoidRadius) 
+		const vec4 field = textureLod(headDistanceField, (position - distanceFieldMinimum) / distanceFieldSize, 0.0);
+		normal = normalizeOrUp(field.xyz);
+		return field.w;
+	}
+
+	const vec4 shape = colliders[colliderIndex].shape;
+	switch (colliders[colliderIndex].type)
+	{
+		case PLANE:
+			normal = vec3(0.0, 1.0, 0.0);
+			return position.y;
+
+		case CAPSULE:
 		{
-			transformedPosition = normalize(transformedPosition) * (ellipsoidRadius + curlRadius);
-			particlePosition = vec3(ellipsoids[i] * vec4(transformedPosition, 1.f));
+			const vec3 axisPoint = vec3(0.0, clamp(position.y, -shape.x, shape.x), 0.0);
+			normal = normalizeOrUp(position - axisPoint);
+			return length(position - axisPoint) - shape.y;
 		}
+
+		case BOX:
+		{
+			const vec3 excess = abs(position) - shape.xyz;
+			if (any(greaterThan(excess, vec3(0.0))))
+			{
+				normal = normalize(max(excess, vec3(0.0))) * sign(position);
+				return length(max(excess, vec3(0.0)));
+			}
+
+			// Inside, the closest face is the one with the smallest penetration
+			const int axis = excess.x > excess.y ? (excess.x > excess.z ? 0 : 2) : (excess.y > excess.z ? 1 : 2);
+			normal = vec3(0.0);
+			normal[axis] = position[axis] >= 0.0 ? 1.0 : -1.0;
+			return excess[axis];
+		}
+
+		default:	// Sphere, and ellipsoid which is a sphere in its own space
+			normal = normalizeOrUp(position);
+			return length(position) - shape.x;
 	}
 }
 
-void moveParticles()
+/*
+* Relative path of the particle in collider space is sphere traced from its position at the start of the step in
+* previous collider space, so particles can't pass through thin or fast moving colliders. End position is moved to
+* the first point of the path closer than offset to the surface, and then out of the collider. Particles already
+* touching the collider at the start just get projected out. Paths grazing the surface can take more steps than
+* SWEEP_MAX_STEPS to cover, these stop at the last point known to be outside instead of skipping the rest of the path.
+* Returns false without contact.
+*/
+bool sweepCollider(in uint colliderIndex, in vec3 startPosition, inout vec3 endPosition, in float offset, out vec3 normal)
 {
-	if (gl_GlobalInvocationID.x > hairData.strandCount)
-		return; 
+	float surfaceDistance = getColliderDistance(colliderIndex, startPosition, normal);
+	const float pathLength = length(endPosition - startPosition);
+	bool hit = false;
+	if (surfaceDistance >= offset + SWEEP_TOLERANCE && pathLength > 0.0)
+	{
+		float t = 0.0;
+		bool covered = false;
+		for (uint i = 0; i < SWEEP_MAX_STEPS; ++i)
+		{
+			t += (surfaceDistance - offset) / pathLength;
+			if (t >= 1.0)
+			{
+				covered = true;
+				break;
+			}
 
-	vec3 particlePositions[MAX_VERTICES_PER_STRAND];
-	vec3 particleVelocities[MAX_VERTICES_PER_STRAND];
+			surfaceDistance = getColliderDistance(colliderIndex, mix(startPosition, endPosition, t), normal);
+			if (surfaceDistance < offset + SWEEP_TOLERANCE)
+			{
+				endPosition = mix(startPosition, endPosition, t);
+				hit = true;
+				break;
+			}
+		}
+
+		if (!covered && !hit)
+		{
+			endPosition = mix(startPosition, endPosition, t);
+			hit = true;
+		}
+	}
 
-	uint offset = gl_GlobalInvocationID.x * hairData.particlesPerStrand;
+	surfaceDistance = getColliderDistance(colliderIndex, endPosition, normal);
+	if (!hit && surfaceDistance >= offset)
+		return false;
 
-	for (uint i = 0; i < hairData.particlesPerStrand; ++i)
+	endPosition += normal * max(offset - surfaceDistance, 0.0);
+	return true;
+}
+
+// Particle is moved with collider space position, contact velocity is the velocity of that point of the collider
+void setContact(in mat4 transform, in mat4 inverseTransform, in mat4 previousTransform, in vec3 localPosition, in vec3 localNormal,
+	inout vec3 particlePosition, inout vec3 contactVelocity, inout vec3 contactNormal)
+{
+	particlePosition = vec3(transform * vec4(localPosition, 1.0));
+	contactVelocity = (particlePosition - vec3(previousTransform * vec4(localPosition, 1.0))) / stepTime;
+	contactNormal = normalize(transpose(mat3(inverseTransform)) * localNormal);
+}
+
+// Particles closer to the head surface than their curl radius are pushed out along distance gradient
+bool resolveDistanceFieldCollision(in vec3 previousPosition, inout vec3 particlePosition, inout vec3 contactVelocity, inout vec3 contactNormal)
+{
+	const mat4 previousModel = culledStep ? culledTransforms[instanceIndex].previousModel : instances[instanceIndex].previousModel;
+	const mat4 previousInverseModel = culledStep ? culledTransforms[instanceIndex].previousInverseModel : instances[instanceIndex].previousInverseModel;
+	const vec3 startPosition = vec3(previousInverseModel * vec4(previousPosition, 1.0));
+	vec3 localPosition = vec3(instances[instanceIndex].inverseModel * vec4(particlePosition, 1.0));
+	const vec3 startCoords = (startPosition - distanceFieldMinimum) / distanceFieldSize;
+	const vec3 coords = (localPosition - distanceFieldMinimum) / distanceFieldSize;
+	if ((any(lessThan(startCoords, vec3(0.0))) || any(greaterThan(startCoords, vec3(1.0))))
+		&& (any(lessThan(coords, vec3(0.0))) || any(greaterThan(coords, vec3(1.0)))))
+		return false;
+
+	vec3 normal;
+	if (!sweepCollider(HEAD_DISTANCE_FIELD, startPosition, localPosition, instances[instanceIndex].curlRadius * strand.curlScale, normal))
+		return false;
+
+	setContact(instances[instanceIndex].model, instances[instanceIndex].inverseModel, previousModel, localPosition, normal,
+		particlePosition, contactVelocity, contactNormal);
+	return true;
+}
+
+/*
+* Offset keeps curled strands off the surface. In a culled step, head ellipsoids are swept from where their instance
+* was at its last culled rate step, other colliders only through their motion during the last step.
+*/
+bool resolveCollider(in uint colliderIndex, in float offset, in vec3 previousPosition, inout vec3 particlePosition, inout vec3 contactVelocity, inout vec3 contactNormal)
+{
+	mat4 previousTransform = colliders[colliderIndex].previousTransform;
+	mat4 previousInverseTransform = colliders[colliderIndex].previousInverseTransform;
+	if (culledStep && colliderIndex < headEllipsoidColliderCount)
 	{
-		const uint particleOffset = offset + i;
-		// Positions
-		particlePositions[i].x = positions[particleOffset][0];
-		particlePositions[i].y = positions[particleOffset][1];
-		particlePositions[i].z = positions[particleOffset][2];
+		const uint owner = colliderIndex / ELLIPSOIDS_PER_INSTANCE;
+		previousTransform = culledTransforms[owner].previousModel * instances[owner].inverseModel * colliders[colliderIndex].transform;
+		previousInverseTransform = colliders[colliderIndex].inverseTransform * instances[owner].model * culledTransforms[owner].previousInverseModel;
+	}
 
-		// Velocities
-		particleVelocities[i].x = velocities[particleOffset][0];
-		particleVelocities[i].y = velocities[particleOffset][1];
-		particleVelocities[i].z = velocities[particleOffset][2];
+	const vec3 startPosition = vec3(previousInverseTransform * vec4(previousPosition, 1.0));
+	vec3 localPosition = vec3(colliders[colliderIndex].inverseTransform * vec4(particlePosition, 1.0));
+	vec3 normal;
+	if (!sweepCollider(colliderIndex, startPosition, localPosition, offset, normal))
+		return false;
+
+	setContact(colliders[colliderIndex].transform, colliders[colliderIndex].inverseTransform, previousTransform, localPosition, normal,
+		particlePosition, contactVelocity, contactNormal);
+	return true;
+}
+
+/*
+* Planes and colliders overlapping any grid cell of the bounds of the particle path during the step, so a particle
+* moving further than a cell is still swept against colliders it passes by. Colliders listed in several of these cells
+* are resolved only once, up to MAX_SWEPT_COLLIDERS of them.
+*/
+bool resolveColliders(in vec3 previousPosition, inout vec3 particlePosition, inout vec3 contactVelocity, inout vec3 contactNormal)
+{
+	const float offset = instances[instanceIndex].curlRadius * strand.curlScale;
+	bool contact = false;
+	for (uint i = 0; i < colliderPlaneCount; ++i)
+	{
+		if (resolveCollider(colliderIndices[i], offset, previousPosition, particlePosition, contactVelocity, contactNormal))
+			contact = true;
 	}
 
-	particlePositions[0] = vec3(model * vec4(particlePositions[0], 1.f));
+	// Clamped before conversion, so far away particles don't overflow cell coordinates
+	const vec3 resolution = vec3(colliderGridResolution);
+	const ivec3 lowest = ivec3(floor(clamp((min(previousPosition, particlePosition) - colliderGridMinimum) / colliderCellSize, vec3(-1.0), resolution)));
+	const ivec3 highest = ivec3(floor(clamp((max(previousPosition, particlePosition) - colliderGridMinimum) / colliderCellSize, vec3(-1.0), resolution)));
+	if (any(lessThan(highest, ivec3(0))) || any(greaterThanEqual(lowest, ivec3(colliderGridResolution))))
+		return contact;
+
+	const ivec3 first = max(lowest, ivec3(0));
+	const ivec3 last = min(highest, ivec3(colliderGridResolution) - 1);
+	uint resolved[MAX_SWEPT_COLLIDERS];
+	uint resolvedCount = 0;
+	for (int z = first.z; z <= last.z; ++z)
+	{
+		for (int y = first.y; y <= last.y; ++y)
+		{
+			for (int x = first.x; x <= last.x; ++x)
+			{
+				const uvec2 cellColliders = colliderCells[(z * colliderGridResolution.y + y) * colliderGridResolution.x + x];
+				for (uint i = 0; i < cellColliders.y; ++i)
+				{
+					const uint colliderIndex = colliderIndices[cellColliders.x + i];
+					bool alreadyResolved = false;
+					for (uint j = 0; j < resolvedCount; ++j)
+						alreadyResolved = alreadyResolved || resolved[j] == colliderIndex;
+
+					if (alreadyResolved)
+						continue;
+
+					if (resolvedCount < MAX_SWEPT_COLLIDERS)
+						resolved[resolvedCount++] = colliderIndex;
+
+					if (resolveCollider(colliderIndex, offset, previousPosition, particlePosition, contactVelocity, contactNormal))
+						contact = true;
+				}
+			}
+		}
+	}
+
+	return contact;
+}
+
+// Moves particle from the previous position out of the head and colliders, returns velocity and normal of the last contact
+bool resolveBodyCollision(in vec3 previousPosition, inout vec3 particlePosition, out vec3 contactVelocity, out vec3 contactNormal)
+{
+	contactVelocity = vec3(0.0);
+	contactNormal = vec3(0.0);
+	bool contact = false;
+	if (distanceFieldCollision && resolveDistanceFieldCollision(previousPosition, particlePosition, contactVelocity, contactNormal))
+		contact = true;
+
+	if (resolveColliders(previousPosition, particlePosition, contactVelocity, contactNormal))
+		contact = true;
+
+	return contact;
+}
+
+// Awake strands are appended to the active list, which is the only work of FTL stage
+void buildActiveList()
+{
+	const uint strandIndex = gl_GlobalInvocationID.x;
+	if (strandIndex >= hairData.strandCount)
+		return;
+
+	if (wakeStrands)
+		strandRestSteps[strandIndex] = 0;
+	else if (strandRestSteps[strandIndex] >= sleepSteps)
+		return;
+
+	const uint activeIndex = atomicAdd(activeStrandCount, 1);
+	activeStrands[activeIndex] = strandIndex;
+
+	// First strand of every work group adds the group to indirect dispatch
+	if (activeIndex % gl_WorkGroupSize.x == 0)
+		atomicAdd(activeGroupCountX, 1);
+}
+
+// Strand falls asleep with zero velocity after sleepSteps steps below sleep energy
+void updateRestSteps(in uint strandIndex, inout vec3 particleVelocities[MAX_VERTICES_PER_STRAND])
+{
+	float kineticEnergy = 0.0;
+	for (uint i = 1; i < hairData.particlesPerStrand; ++i)
+		kineticEnergy += 0.5 * strand.particleMass * dot(particleVelocities[i], particleVelocities[i]);
+
+	if (kineticEnergy >= sleepEnergy * (hairData.particlesPerStrand - 1))
+	{
+		strandRestSteps[strandIndex] = 0;
+		return;
+	}
+
+	strandRestSteps[strandIndex] += 1;
+	if (strandRestSteps[strandIndex] >= sleepSteps)
+	{
+		for (uint i = 1; i < hairData.particlesPerStrand; ++i)
+			particleVelocities[i] = vec3(0.0);
+	}
+}
+
+vec3 getRestPosition(in uint particle)
+{
+	const uint index = strandOffset + particle;
+	return vec3(restPositions[index][0], restPositions[index][1], restPositions[index][2]);
+}
+
+vec3 getWorldRestPosition(in uint particle)
+{
+	return vec3(instances[instanceIndex].model * vec4(getRestPosition(particle), 1.0));
+}
+
+float getStrandStiffness()
+{
+	return clamp(strand.stiffness + bendingStiffness, 0.0, 1.0);
+}
+
+// Rotates vector by the shortest rotation taking unit direction from onto unit direction to
+vec3 rotateBetween(in vec3 from, in vec3 to, in vec3 vector)
+{
+	const float cosine = dot(from, to);
+	if (cosine < -0.9999)
+		return reflect(vector, from);
+
+	const vec3 axis = cross(from, to);
+	return vector * cosine + cross(axis, vector) + axis * dot(axis, vector) / (1.0 + cosine);
+}
+
+/*
+* Direction of the segment ending at the particle in rest shape, rotated along with the previous segment from its rest
+* direction. First segment has no previous one and keeps its rest direction relative to the head.
+*/
+vec3 getRestDirection(in uint particle, in vec3 previousSegment)
+{
+	const mat3 model = mat3(instances[instanceIndex].model);
+	const vec3 restDirection = normalizeOrUp(model * (getRestPosition(particle) - getRestPosition(particle - 1)));
+	if (particle == 1)
+		return restDirection;
+
+	const vec3 previousRestDirection = normalizeOrUp(model * (getRestPosition(particle - 1) - getRestPosition(particle - 2)));
+	return rotateBetween(previousRestDirection, normalizeOrUp(previousSegment), restDirection);
+}
+
+/*
+* Distance between the particle and the one two segments before it in rest shape. Rest shape is in hair local space
+* while stretch constraints use segment length, so the distance is taken relative to the rest length of the two
+* segments. Bending then agrees with stretch under any scale of the hair or of the pose the rest shape was captured in.
+*/
+float getRestBendingLength(in uint particle)
+{
+	const vec3 previousSegment = getRestPosition(particle - 1) - getRestPosition(particle - 2);
+	const vec3 segment = getRestPosition(particle) - getRestPosition(particle - 1);
+	const float restLength = length(previousSegment) + length(segment);
+	if (restLength == 0.0)
+		return 2.0 * strand.segmentLength;
+
+	return length(previousSegment + segment) / restLength * 2.0 * strand.segmentLength;
+}
+
+// Particle takes collider velocity along contact normal and keeps sliding along the surface
+vec3 applyContactVelocity(in vec3 particleVelocity, in vec3 contactVelocity, in vec3 contactNormal)
+{
+	const vec3 relativeVelocity = particleVelocity - contactVelocity;
+	return particleVelocity - dot(relativeVelocity, contactNormal) * contactNormal;
+}
 
+// Single pass from root to tip, every particle is moved to segment length from its already solved leader
+void solveFollowTheLeader(inout vec3 particlePositions[MAX_VERTICES_PER_STRAND], inout vec3 particleVelocities[MAX_VERTICES_PER_STRAND])
+{
 	vec3 forces, proposedPosition;
 	vec3 positionCorrectionVector[MAX_VERTICES_PER_STRAND];
 	for (uint i = 1; i < hairData.particlesPerStrand; ++i) 
@@ -247,9 +782,23 @@ void moveParticles()
 		forces += generateGravityForce();
 		proposedPosition = integrateHeun(forces, particlePositions[i], particleVelocities[i]);
 		// proposedPosition = integrateExplicitEuler(forces, particlePositions[i], particleVelocities[i]);
-		proposedPosition = followTheLeader(particlePositions[i - 1], proposedPosition, positionCorrectionVector[i]);
-		resolveBodyCollision(proposedPosition);
+		if (getStrandStiffness() > 0.0)
+		{
+			// Stiff strands keep their rest angle to the previous segment
+			const vec3 previousSegment = i > 1 ? particlePositions[i - 1] - particlePositions[i - 2] : vec3(0.0);
+			proposedPosition = mix(proposedPosition, particlePositions[i - 1] + getRestDirection(i, previousSegment) * strand.segmentLength, getStrandStiffness());
+		}
+
+		if (shapeStiffness > 0.0)
+			proposedPosition = mix(proposedPosition, getWorldRestPosition(i), shapeStiffness);
+
+		proposedPosition = followTheLeader(particlePositions[i - 1], proposedPosition, strand.segmentLength, positionCorrectionVector[i]);
+		vec3 contactVelocity, contactNormal;
+		const bool contact = resolveBodyCollision(particlePositions[i], proposedPosition, contactVelocity, contactNormal);
 		particleVelocities[i] = updateVelocity(particlePositions[i], proposedPosition);
+		if (contact)
+			particleVelocities[i] = applyContactVelocity(particleVelocities[i], contactVelocity, contactNormal);
+
 		particlePositions[i] = proposedPosition;
 	}
 
@@ -257,6 +806,124 @@ void moveParticles()
 	{
 		particleVelocities[i] = correctFtlVelocity(particleVelocities[i], positionCorrectionVector[i + 1]);
 	}
+}
+
+// XPBD update of a distance constraint between two particles, weights are inverse masses
+void solveDistanceConstraint(inout vec3 firstPosition, inout vec3 secondPosition, in float firstWeight, in float secondWeight,
+	in float restLength, in float alpha, inout float lambda)
+{
+	const vec3 difference = secondPosition - firstPosition;
+	const float currentLength = length(difference);
+	if (currentLength == 0.0 || firstWeight + secondWeight + alpha == 0.0)
+		return;
+
+	const vec3 gradient = difference / currentLength;
+	const float deltaLambda = (restLength - currentLength - alpha * lambda) / (firstWeight + secondWeight + alpha);
+	lambda += deltaLambda;
+	firstPosition -= firstWeight * deltaLambda * gradient;
+	secondPosition += secondWeight * deltaLambda * gradient;
+}
+
+/*
+* Extended position based dynamics with stretch constraints between neighbouring particles and bending constraints
+* between particles two segments apart at their rest shape distance, both measured in segment lengths. One invocation
+* owns the whole strand, so constraints are solved with Gauss-Seidel iterations from root to tip without any
+* conflicting writes. Compliance is time step independent, bending compliance is scaled down by strand stiffness.
+*/
+void solveXpbd(inout vec3 particlePositions[MAX_VERTICES_PER_STRAND], inout vec3 particleVelocities[MAX_VERTICES_PER_STRAND])
+{
+	const float inverseMass = 1.0 / strand.particleMass;
+	const float stretchAlpha = stretchCompliance / (stepTime * stepTime);
+	const float bendingAlpha = bendingCompliance * (1.0 - getStrandStiffness()) / (stepTime * stepTime);
+
+	vec3 predictedPositions[MAX_VERTICES_PER_STRAND];
+	float stretchLambdas[MAX_VERTICES_PER_STRAND];
+	float bendingLambdas[MAX_VERTICES_PER_STRAND];
+	predictedPositions[0] = particlePositions[0];
+	for (uint i = 1; i < hairData.particlesPerStrand; ++i)
+	{
+		const vec3 forces = generateWindForce(particlePositions[i]) + generateGravityForce();
+		predictedPositions[i] = particlePositions[i] + stepTime * (particleVelocities[i] + stepTime * forces * inverseMass);
+		if (shapeStiffness > 0.0)
+			predictedPositions[i] = mix(predictedPositions[i], getWorldRestPosition(i), shapeStiffness);
+
+		stretchLambdas[i] = 0.0;
+		bendingLambdas[i] = 0.0;
+	}
+
+	// Root is attached to the head and has zero weight
+	for (uint iteration = 0; iteration < solverIterations; ++iteration)
+	{
+		for (uint i = 1; i < hairData.particlesPerStrand; ++i)
+		{
+			solveDistanceConstraint(predictedPositions[i - 1], predictedPositions[i], i == 1 ? 0.0 : inverseMass, inverseMass,
+				strand.segmentLength, stretchAlpha, stretchLambdas[i]);
+			if (i > 1)
+				solveDistanceConstraint(predictedPositions[i - 2], predictedPositions[i], i == 2 ? 0.0 : inverseMass, inverseMass,
+					getRestBendingLength(i), bendingAlpha, bendingLambdas[i]);
+		}
+	}
+
+	for (uint i = 1; i < hairData.particlesPerStrand; ++i)
+	{
+		vec3 contactVelocity, contactNormal;
+		const bool contact = resolveBodyCollision(particlePositions[i], predictedPositions[i], contactVelocity, contactNormal);
+		particleVelocities[i] = updateVelocity(particlePositions[i], predictedPositions[i]);
+		if (contact)
+			particleVelocities[i] = applyContactVelocity(particleVelocities[i], contactVelocity, contactNormal);
+
+		particlePositions[i] = predictedPositions[i];
+	}
+}
+
+void moveParticles()
+{
+	uint strandIndex = gl_GlobalInvocationID.x;
+	if (sleeping)
+	{
+		if (strandIndex >= activeStrandCount)
+			return;
+
+		strandIndex = activeStrands[strandIndex];
+	}
+	else if (strandIndex >= hairData.strandCount)
+		return; 
+
+	vec3 particlePositions[MAX_VERTICES_PER_STRAND];
+	vec3 particleVelocities[MAX_VERTICES_PER_STRAND];
+
+	uint offset = strandIndex * hairData.particlesPerStrand;
+	strandOffset = offset;
+	instanceIndex = strandIndex / hairData.strandsPerInstance;
+	if (isInstanceSkipped())
+		return;
+
+	loadInstanceStep();
+
+	strand = strandAttributes[strandIndex];
+
+	for (uint i = 0; i < hairData.particlesPerStrand; ++i)
+	{
+		const uint particleOffset = offset + i;
+		// Positions
+		particlePositions[i].x = positions[particleOffset][0];
+		particlePositions[i].y = positions[particleOffset][1];
+		particlePositions[i].z = positions[particleOffset][2];
+
+		// Velocities
+		particleVelocities[i].x = velocities[particleOffset][0];
+		particleVelocities[i].y = velocities[particleOffset][1];
+		particleVelocities[i].z = velocities[particleOffset][2];
+	}
+
+	particlePositions[0] = vec3(instances[instanceIndex].model * vec4(particlePositions[0], 1.f));
+	if (solver == XPBD)
+		solveXpbd(particlePositions, particleVelocities);
+	else
+		solveFollowTheLeader(particlePositions, particleVelocities);
+
+	if (sleeping)
+		updateRestSteps(strandIndex, particleVelocities);
 
 	for (uint i = 1; i < hairData.particlesPerStrand; ++i)
 	{
@@ -286,5 +953,9 @@ void main(void)
 		case COLLISIONS:
 			addHairFriction();
 			break;
+
+		case BUILD_ACTIVE_LIST:
+			buildActiveList();
+			break;
 	}
 }
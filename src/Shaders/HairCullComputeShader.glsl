@@ -0,0 +1,159 @@
+#version 450 core
+#define STRANDS 0
+#define INSTANCES 1
+
+layout (local_size_x = 128) in;
+
+layout (std430, binding = 0) readonly buffer HairPosition {
+	float positions[][3];
+};
+
+struct HairInstance {
+	mat4 model;
+	mat4 inverseModel;
+	mat4 previousModel;
+	mat4 previousInverseModel;
+	vec4 wind;
+	float gravity;
+	float frictionCoefficient;
+	float velocityDampingCoefficient;
+	float curlRadius;
+	float volumeRepulsion;
+};
+
+layout (std430, binding = 5) readonly buffer HairInstanceBuffer {
+	HairInstance instances[];
+};
+
+// Written for hair system instances, 0 marks culled ones
+layout (std430, binding = 7) writeonly buffer InstanceVisibilityBuffer {
+	uint instanceVisibility[];
+};
+
+struct DrawArraysIndirectCommand {
+	uint count;
+	uint instanceCount;
+	uint first;
+	uint baseInstance;
+};
+
+layout (std430, binding = 8) writeonly buffer DrawCommandBuffer {
+	DrawArraysIndirectCommand commands[];
+};
+
+layout (std430, binding = 9) buffer DrawCountBuffer {
+	uint drawCount;
+};
+
+uniform uint mode;
+uniform uint itemCount;
+uniform vec4 frustumPlanes[6];
+uniform mat4 view;
+uniform mat4 projection;
+uniform float nearPlane;
+
+// Strand mode
+uniform mat4 model;
+uniform uint particlesPerStrand;
+uniform float radiusMargin;
+
+// Instance mode
+uniform float instanceRadius;
+uniform uint instanceVertexCount;
+
+uniform bool occlusionCulling;
+uniform sampler2D hierarchicalDepth;
+uniform int hierarchicalDepthLevels;
+
+bool isOutsideFrustum(in vec3 center, in float radius)
+{
+	for (uint i = 0; i < 6; ++i)
+	{
+		if (dot(frustumPlanes[i], vec4(center, 1.0)) < -radius)
+			return true;
+	}
+
+	return false;
+}
+
+// Conservative screen rectangle of the sphere is compared with the furthest occluder depth under it
+bool isOccluded(in vec3 center, in float radius)
+{
+	const vec3 viewCenter = vec3(view * vec4(center, 1.0));
+	const float nearestDistance = -viewCenter.z - radius;
+	const float furthestDistance = -viewCenter.z + radius;
+	if (nearestDistance < nearPlane)
+		return false;
+
+	const vec2 lowerCorner = viewCenter.xy - radius;
+	const vec2 upperCorner = viewCenter.xy + radius;
+	const vec2 focal = vec2(projection[0][0], projection[1][1]);
+	const vec2 lowerNdc = focal * lowerCorner / mix(vec2(furthestDistance), vec2(nearestDistance), lessThan(lowerCorner, vec2(0.0)));
+	const vec2 upperNdc = focal * upperCorner / mix(vec2(furthestDistance), vec2(nearestDistance), greaterThan(upperCorner, vec2(0.0)));
+	const vec2 lowerUv = clamp(lowerNdc * 0.5 + 0.5, 0.0, 1.0);
+	const vec2 upperUv = clamp(upperNdc * 0.5 + 0.5, 0.0, 1.0);
+
+	// Level where the rectangle spans at most two texels in each direction
+	const vec2 rectangleSize = (upperUv - lowerUv) * vec2(textureSize(hierarchicalDepth, 0));
+	const int level = clamp(int(ceil(log2(max(max(rectangleSize.x, rectangleSize.y), 1.0)))), 0, hierarchicalDepthLevels - 1);
+	const ivec2 levelSize = textureSize(hierarchicalDepth, level);
+	const ivec2 lowerTexel = clamp(ivec2(lowerUv * levelSize), ivec2(0), levelSize - 1);
+	const ivec2 upperTexel = min(clamp(ivec2(upperUv * levelSize), ivec2(0), levelSize - 1), lowerTexel + 1);
+
+	float occluderDepth = 0.0;
+	for (int y = lowerTexel.y; y <= upperTexel.y; ++y)
+	{
+		for (int x = lowerTexel.x; x <= upperTexel.x; ++x)
+			occluderDepth = max(occluderDepth, texelFetch(hierarchicalDepth, ivec2(x, y), level).r);
+	}
+
+	const vec4 nearestPoint = projection * vec4(0.0, 0.0, -nearestDistance, 1.0);
+	return nearestPoint.z / nearestPoint.w * 0.5 + 0.5 > occluderDepth;
+}
+
+bool isVisible(in vec3 center, in float radius)
+{
+	return !isOutsideFrustum(center, radius) && !(occlusionCulling && isOccluded(center, radius));
+}
+
+void appendCommand(in DrawArraysIndirectCommand command)
+{
+	commands[atomicAdd(drawCount, 1)] = command;
+}
+
+void cullStrand(in uint strand)
+{
+	const uint offset = strand * particlesPerStrand;
+	vec3 lower = vec3(model * vec4(positions[offset][0], positions[offset][1], positions[offset][2], 1.0));
+	vec3 upper = lower;
+	for (uint i = 1; i < particlesPerStrand; ++i)
+	{
+		const vec3 position = vec3(positions[offset + i][0], positions[offset + i][1], positions[offset + i][2]);
+		lower = min(lower, position);
+		upper = max(upper, position);
+	}
+
+	if (isVisible(0.5 * (lower + upper), 0.5 * length(upper - lower) + radiusMargin))
+		appendCommand(DrawArraysIndirectCommand(particlesPerStrand, 1, offset, 0));
+}
+
+void cullInstance(in uint instance)
+{
+	const mat4 instanceModel = instances[instance].model;
+	const float scale = max(1.0, max(length(instanceModel[0].xyz), max(length(instanceModel[1].xyz), length(instanceModel[2].xyz))));
+	const bool visible = isVisible(vec3(instanceModel[3]), instanceRadius * scale);
+	instanceVisibility[instance] = visible ? 1 : 0;
+	if (visible)
+		appendCommand(DrawArraysIndirectCommand(instanceVertexCount, 1, 0, instance));
+}
+
+void main(void)
+{
+	if (gl_GlobalInvocationID.x >= itemCount)
+		return;
+
+	if (mode == STRANDS)
+		cullStrand(gl_GlobalInvocationID.x);
+	else
+		cullInstance(gl_GlobalInvocationID.x);
+}
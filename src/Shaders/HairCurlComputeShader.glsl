@@ -0,0 +1,96 @@
+#version 450 core
+#define TWO_PI 6.28318530718
+
+layout (local_size_x = 128) in;
+
+layout (std430, binding = 0) readonly buffer HairPosition {
+	float positions[][3];
+};
+
+struct StrandAttributes {
+	vec4 color;
+	float segmentLength;
+	float curlScale;
+	float particleMass;
+	float stiffness;
+};
+
+layout (std430, binding = 4) readonly buffer StrandAttributeBuffer {
+	StrandAttributes strandAttributes[];
+};
+
+struct CurledVertex {
+	vec4 position;
+	vec4 tangent;
+};
+
+// Every strand is written as a continuous line strip of pointsPerStrand vertices
+layout (std430, binding = 6) writeonly buffer CurledVertexBuffer {
+	CurledVertex curledVertices[];
+};
+
+uniform mat4 model;
+uniform uint particlesPerStrand;
+uniform uint strandCount;
+uniform uint subdivisionCount;
+uniform float curlRadius = 0.05f;
+
+vec3 getParticlePosition(in uint index)
+{
+	const vec3 position = vec3(positions[index][0], positions[index][1], positions[index][2]);
+	if (index % particlesPerStrand == 0)
+		return vec3(model * vec4(position, 1.f));
+
+	return position;
+}
+
+// Uniform Catmull-Rom spline through start and end, tangent is its derivative
+vec3 catmullRom(in vec3 p0, in vec3 p1, in vec3 p2, in vec3 p3, in float t, out vec3 tangent)
+{
+	const vec3 a = 2.f * p1;
+	const vec3 b = p2 - p0;
+	const vec3 c = 2.f * p0 - 5.f * p1 + 4.f * p2 - p3;
+	const vec3 d = 3.f * (p1 - p2) + p3 - p0;
+	tangent = 0.5f * (b + t * (2.f * c + t * 3.f * d));
+	return 0.5f * (a + t * (b + t * (c + t * d)));
+}
+
+void main()
+{
+	const uint segmentsPerStrand = particlesPerStrand - 1;
+	const uint pointsPerStrand = segmentsPerStrand * subdivisionCount + 1;
+	if (gl_GlobalInvocationID.x >= strandCount * pointsPerStrand)
+		return;
+
+	const uint strand = gl_GlobalInvocationID.x / pointsPerStrand;
+	const uint point = gl_GlobalInvocationID.x % pointsPerStrand;
+
+	// Last point of the strand is the end of the last segment
+	const uint segmentIndex = min(point / subdivisionCount, segmentsPerStrand - 1);
+	const float t = float(point - segmentIndex * subdivisionCount) / float(subdivisionCount);
+	const uint particle = strand * particlesPerStrand + segmentIndex;
+	const vec3 start = getParticlePosition(particle);
+	const vec3 end = getParticlePosition(particle + 1);
+
+	// Missing neighbours at strand ends are extrapolated, so spline continues in the same direction
+	const vec3 previous = segmentIndex > 0 ? getParticlePosition(particle - 1) : 2.f * start - end;
+	const vec3 next = segmentIndex + 1 < segmentsPerStrand ? getParticlePosition(particle + 2) : 2.f * end - start;
+
+	// Same helix as HairGeometryShader, one full turn per segment, but around the smooth strand
+	vec3 tangent;
+	vec3 position = catmullRom(previous, start, end, next, t, tangent);
+	const vec3 segment = tangent;
+	const float strandCurlRadius = curlRadius * strandAttributes[strand].curlScale;
+	if (strandCurlRadius != 0.f)
+	{
+		const vec3 hairDirection = normalize(segment);
+		const vec3 uDirection = normalize(cross(hairDirection, vec3(0.f, 1.f, 0.f)));
+		const vec3 vDirection = normalize(cross(hairDirection, uDirection));
+		const float angle = TWO_PI * t;
+		position += strandCurlRadius * (uDirection * cos(angle) + vDirection * sin(angle));
+		tangent += strandCurlRadius * TWO_PI * (vDirection * cos(angle) - uDirection * sin(angle));
+	}
+
+	curledVertices[gl_GlobalInvocationID.x].position = vec4(position, 1.f);
+	curledVertices[gl_GlobalInvocationID.x].tangent = vec4(normalize(tangent), 0.f);
+}
@@ -0,0 +1,45 @@
+#version 460 core
+
+struct CurledVertex {
+	vec4 position;
+	vec4 tangent;
+};
+
+layout (std430, binding = 6) readonly buffer CurledVertexBuffer {
+	CurledVertex curledVertices[];
+};
+
+struct StrandAttributes {
+	vec4 color;
+	float segmentLength;
+	float curlScale;
+	float particleMass;
+	float stiffness;
+};
+
+layout (std430, binding = 4) readonly buffer StrandAttributeBuffer {
+	StrandAttributes strandAttributes[];
+};
+
+out Attributes {
+	vec3 fragPosition;
+	vec3 tangent;
+	vec4 color;
+	float curlScale;
+} outAttributes;
+
+invariant gl_Position;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform uint pointsPerStrand;
+
+void main()
+{
+	const StrandAttributes strand = strandAttributes[gl_VertexID / pointsPerStrand];
+	outAttributes.fragPosition = curledVertices[gl_VertexID].position.xyz;
+	outAttributes.tangent = curledVertices[gl_VertexID].tangent.xyz;
+	outAttributes.color = strand.color;
+	outAttributes.curlScale = strand.curlScale;
+	gl_Position = projection * view * vec4(outAttributes.fragPosition, 1.f);
+}
@@ -5,6 +5,7 @@ struct Material {
 	vec3 diffuse;
 	vec3 specular;
 	float shininess;
+	bool marschner;
 };
 
 struct Light {
@@ -18,11 +19,30 @@ struct Light {
 in Attributes {
 	vec3 fragPosition;
 	vec3 tangent;
+	vec4 color;
+	float curlScale;
 } inAttributes;
 
+// Second output is written only into weighted blended OIT buffers
+layout (location = 0) out vec4 fragColor;
+layout (location = 1) out vec4 revealage;
+
 uniform Light light;
 uniform vec3 eyePosition;
 uniform Material material;
+uniform float opacity = 1.f;
+uniform bool orderIndependent = false;
+
+// Deep opacity map, four depth slices per layer
+uniform bool selfShadowing = false;
+uniform sampler2DArray opacityMap;
+uniform mat4 lightViewProjection;
+uniform int opacitySliceCount;
+uniform float shadowAbsorption;
+
+// Marschner R, TT and TRT lobes, see MarschnerLut
+uniform sampler2D longitudinalLut;
+uniform sampler2D azimuthalLut;
 
 float attenuation(in Light light) 
 {
@@ -31,27 +51,94 @@ float attenuation(in Light light)
 	return attenuation;
 }
 
+float sliceOpacity(in vec2 texCoords, in int slice)
+{
+	if (slice < 0)
+		return 0.f;
+
+	return texture(opacityMap, vec3(texCoords, slice / 4))[slice % 4];
+}
+
+// Fraction of light that reaches fragment through strands in front of it
+float transmittance()
+{
+	if (!selfShadowing)
+		return 1.f;
+
+	vec4 lightPosition = lightViewProjection * vec4(inAttributes.fragPosition, 1.f);
+	vec3 mapPosition = lightPosition.xyz / lightPosition.w * 0.5f + 0.5f;
+	if (any(lessThan(mapPosition, vec3(0.f))) || any(greaterThan(mapPosition, vec3(1.f))))
+		return 1.f;
+
+	// Slice k holds strands in front of its far end, biased by half a slice so strand doesn't shadow itself
+	float slice = mapPosition.z * opacitySliceCount - 1.5f;
+	int nearSlice = int(floor(slice));
+	float strandCount = mix(sliceOpacity(mapPosition.xy, nearSlice), sliceOpacity(mapPosition.xy, min(nearSlice + 1, opacitySliceCount - 1)), fract(slice));
+	return exp(-shadowAbsorption * strandCount);
+}
+
+// Scattered radiance split into specular R lobe and colored TT + TRT lobes
+void marschnerScattering(in vec3 lightDirection, in vec3 eyeDirection, out float specular, out float transmitted)
+{
+	float sinThetaI = dot(lightDirection, inAttributes.tangent);
+	float sinThetaR = dot(eyeDirection, inAttributes.tangent);
+	vec4 longitudinal = texture(longitudinalLut, vec2(sinThetaI, sinThetaR) * 0.5f + 0.5f);
+
+	vec3 lightNormal = lightDirection - sinThetaI * inAttributes.tangent;
+	vec3 eyeNormal = eyeDirection - sinThetaR * inAttributes.tangent;
+	float cosPhi = dot(lightNormal, eyeNormal) * inversesqrt(dot(lightNormal, lightNormal) * dot(eyeNormal, eyeNormal) + 1e-4f);
+	vec3 azimuthal = texture(azimuthalLut, vec2(cosPhi * 0.5f + 0.5f, longitudinal.a)).rgb;
+
+	vec3 lobes = longitudinal.rgb * azimuthal * sqrt(max(1.f - sinThetaI * sinThetaI, 0.f));
+	specular = lobes.r;
+	transmitted = lobes.g + lobes.b;
+}
+
 vec4 calculatePointLight() 
 {
 	// ambient
-	vec3 ambientComponent = material.ambient; 
+	vec3 ambientComponent = material.ambient * inAttributes.color.rgb; 
 
-	// diffuse
 	vec3 lightDirection = normalize(light.position - inAttributes.fragPosition);
+	vec3 eyeDirection = normalize(eyePosition - inAttributes.fragPosition);
+	float shadow = transmittance();
+	if (material.marschner)
+	{
+		float specular, transmitted;
+		marschnerScattering(lightDirection, eyeDirection, specular, transmitted);
+		vec3 scattered = (material.specular * specular + material.diffuse * inAttributes.color.rgb * transmitted) * light.color * shadow;
+		return vec4((ambientComponent + scattered) * attenuation(light), inAttributes.color.a * opacity);
+	}
+
+	// diffuse
 	float lightAngle = acos(abs(dot(lightDirection, inAttributes.tangent)));
-	vec3 diffuseComponent = material.diffuse * light.color * sin(lightAngle);
+	vec3 diffuseComponent = material.diffuse * inAttributes.color.rgb * light.color * sin(lightAngle);
 
 	// specular
-	vec3 eyeDirection = normalize(eyePosition - inAttributes.fragPosition);
 	float eyeAngle = acos(abs(dot(eyeDirection, inAttributes.tangent)));
 	vec3 specularComponent = material.specular * light.color * pow(cos(lightAngle - eyeAngle), material.shininess);
 
-	vec4 result = vec4((ambientComponent + diffuseComponent + specularComponent) * attenuation(light), 1.f);
+	// Ambient light isn't shadowed by other strands
+	diffuseComponent *= shadow;
+	specularComponent *= shadow;
+
+	// Alpha is strand opacity times its coverage of the pixel, which is below one only for ribbons
+	vec4 result = vec4((ambientComponent + diffuseComponent + specularComponent) * attenuation(light), inAttributes.color.a * opacity);
 
 	return result;
 }
 
 void main() 
 {
-	gl_FragColor = calculatePointLight();
+	vec4 color = calculatePointLight();
+	if (!orderIndependent)
+	{
+		fragColor = color;
+		return;
+	}
+
+	// Depth based weight of McGuire and Bavoil, closer and more opaque fragments dominate the average
+	float weight = clamp(pow(min(1.f, color.a * 10.f) + 0.01f, 3.f) * 1e8f * pow(1.f - gl_FragCoord.z * 0.9f, 3.f), 1e-2f, 3e3f);
+	fragColor = vec4(color.rgb * color.a, color.a) * weight;
+	revealage = vec4(color.a);
 }
\ No newline at end of file
@@ -7,20 +7,29 @@ layout(line_strip, max_vertices = VERTICES_BETWEEN) out;
 in Attributes {
 	vec3 fragPosition;
 	vec3 tangent;
+	vec4 color;
+	float curlScale;
 } inAttributes[];
 
 out Attributes {
 	vec3 fragPosition;
 	vec3 tangent;
+	vec4 color;
+	float curlScale;
 } outAttributes;
 
+invariant gl_Position;
+
 uniform mat4 projection;
 uniform mat4 view;
 uniform float curlRadius = 0.05f;
 
 void main(void)
 {
-	if (curlRadius != 0.f)
+	const float strandCurlRadius = curlRadius * inAttributes[0].curlScale;
+	outAttributes.color = inAttributes[0].color;
+	outAttributes.curlScale = inAttributes[0].curlScale;
+	if (strandCurlRadius != 0.f)
 	{
 		const float segmentLength = length(gl_in[0].gl_Position - gl_in[1].gl_Position) / (VERTICES_BETWEEN - 1);
 		const vec3 startingPosition = gl_in[0].gl_Position.xyz;
@@ -33,18 +42,20 @@ void main(void)
 		uint i = 0;
 		vec3 nextPosition;
 		nextPosition = startingPosition + hairDirection * segmentLength * i;
-		nextPosition += curlRadius * uDirection * cos(radians(angleStep) * i);
-		nextPosition += curlRadius * vDirection * sin(radians(angleStep) * i);
+		nextPosition += strandCurlRadius * uDirection * cos(radians(angleStep) * i);
+		nextPosition += strandCurlRadius * vDirection * sin(radians(angleStep) * i);
 
 		for (i = 1; i <= VERTICES_BETWEEN; ++i) 
 		{
+			outAttributes.color = inAttributes[0].color;
+			outAttributes.curlScale = inAttributes[0].curlScale;
 			outAttributes.fragPosition = nextPosition;
 			gl_Position = vec4(nextPosition, 1.f);
 			gl_Position = projection * view * gl_Position;
 			
 			nextPosition = startingPosition + hairDirection * segmentLength * i;
-			nextPosition += curlRadius * uDirection * cos(radians(angleStep) * i);
-			nextPosition += curlRadius * vDirection * sin(radians(angleStep) * i);
+			nextPosition += strandCurlRadius * uDirection * cos(radians(angleStep) * i);
+			nextPosition += strandCurlRadius * vDirection * sin(radians(angleStep) * i);
 			
 			outAttributes.tangent = normalize(nextPosition - outAttributes.fragPosition);
 
@@ -53,6 +64,8 @@ void main(void)
 
 		gl_Position = vec4(nextPosition, 1.f);
 		gl_Position = projection * view * gl_Position;
+		outAttributes.color = inAttributes[0].color;
+		outAttributes.curlScale = inAttributes[0].curlScale;
 		outAttributes.fragPosition = nextPosition;
 		EmitVertex();
 		EndPrimitive();
@@ -65,6 +78,8 @@ void main(void)
 		EmitVertex();
 
 		gl_Position = projection * view * vec4(gl_in[1].gl_Position.xyz, 1.f);
+		outAttributes.color = inAttributes[1].color;
+		outAttributes.curlScale = inAttributes[1].curlScale;
 		outAttributes.fragPosition = inAttributes[1].fragPosition;
 		outAttributes.tangent = normalize(inAttributes[1].fragPosition - inAttributes[0].fragPosition);
 		EmitVertex();
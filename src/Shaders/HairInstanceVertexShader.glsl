@@ -0,0 +1,64 @@
+#version 460 core
+
+// Segments of one hair instance drawn as lines, instance is selected by base instance of its indirect draw command
+layout (std430, binding = 0) readonly buffer HairPosition {
+	float positions[][3];
+};
+
+struct StrandAttributes {
+	vec4 color;
+	float segmentLength;
+	float curlScale;
+	float particleMass;
+	float stiffness;
+};
+
+layout (std430, binding = 4) readonly buffer StrandAttributeBuffer {
+	StrandAttributes strandAttributes[];
+};
+
+struct HairInstance {
+	mat4 model;
+	mat4 inverseModel;
+	mat4 previousModel;
+	mat4 previousInverseModel;
+	vec4 wind;
+	float gravity;
+	float frictionCoefficient;
+	float velocityDampingCoefficient;
+	float curlRadius;
+	float volumeRepulsion;
+};
+
+layout (std430, binding = 5) readonly buffer HairInstanceBuffer {
+	HairInstance instances[];
+};
+
+out Attributes {
+	vec3 fragPosition;
+	vec3 tangent;
+	vec4 color;
+	float curlScale;
+} outAttributes;
+
+invariant gl_Position;
+
+uniform uint particlesPerStrand;
+uniform uint strandsPerInstance;
+
+void main()
+{
+	const uint segmentsPerStrand = particlesPerStrand - 1;
+	const uint segment = gl_VertexID / 2;
+	const uint strand = gl_BaseInstance * strandsPerInstance + segment / segmentsPerStrand;
+	const uint particle = strand * particlesPerStrand + segment % segmentsPerStrand + gl_VertexID % 2;
+
+	outAttributes.fragPosition = vec3(positions[particle][0], positions[particle][1], positions[particle][2]);
+	if (particle % particlesPerStrand == 0)
+		outAttributes.fragPosition = vec3(instances[gl_BaseInstance].model * vec4(outAttributes.fragPosition, 1.f));
+
+	const StrandAttributes attributes = strandAttributes[strand];
+	outAttributes.color = attributes.color;
+	outAttributes.curlScale = attributes.curlScale;
+	gl_Position = vec4(outAttributes.fragPosition, 1.f);
+}
@@ -0,0 +1,14 @@
+#version 460 core
+
+// Four slices per layer of opacity map texture array
+layout (location = 0) out vec4 slices[4];
+
+uniform int sliceCount;
+
+void main()
+{
+	// Fragment counts towards its own slice and every slice behind it
+	const float slice = floor(gl_FragCoord.z * sliceCount);
+	for (int layer = 0; layer < 4; ++layer)
+		slices[layer] = step(vec4(slice), vec4(0.f, 1.f, 2.f, 3.f) + 4.f * layer);
+}
@@ -0,0 +1,74 @@
+#version 460 core
+
+// Every curled line segment is expanded into a camera facing quad of two triangles, 6 vertices per segment
+struct CurledVertex {
+	vec4 position;
+	vec4 tangent;
+};
+
+layout (std430, binding = 6) readonly buffer CurledVertexBuffer {
+	CurledVertex curledVertices[];
+};
+
+struct StrandAttributes {
+	vec4 color;
+	float segmentLength;
+	float curlScale;
+	float particleMass;
+	float stiffness;
+};
+
+layout (std430, binding = 4) readonly buffer StrandAttributeBuffer {
+	StrandAttributes strandAttributes[];
+};
+
+out Attributes {
+	vec3 fragPosition;
+	vec3 tangent;
+	vec4 color;
+	float curlScale;
+} outAttributes;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 eyePosition;
+uniform uint pointsPerStrand;
+uniform float strandWidth;
+uniform float viewportHeight;
+
+// Point offset within segment and side of the ribbon for every quad corner, counter-clockwise towards the camera
+const vec2 corners[6] = vec2[](
+	vec2(0.f, -1.f), vec2(0.f, 1.f), vec2(1.f, -1.f),
+	vec2(0.f, 1.f), vec2(1.f, 1.f), vec2(1.f, -1.f)
+);
+
+void main()
+{
+	const uint segmentsPerStrand = pointsPerStrand - 1;
+	const uint quad = gl_VertexID / 6;
+	const vec2 corner = corners[gl_VertexID % 6];
+	const uint strand = quad / segmentsPerStrand;
+	const uint point = strand * pointsPerStrand + quad % segmentsPerStrand + uint(corner.x);
+
+	vec3 position = curledVertices[point].position.xyz;
+	const vec3 tangent = curledVertices[point].tangent.xyz;
+
+	// Ribbon is never thinner than a pixel, thinner strands only cover part of it
+	const vec4 clipPosition = projection * view * vec4(position, 1.f);
+	const float pixelSize = 2.f * clipPosition.w / (projection[1][1] * viewportHeight);
+	const float width = max(strandWidth, pixelSize);
+	const float coverage = clamp(strandWidth / pixelSize, 0.f, 1.f);
+
+	// Side direction is undefined for segments pointing at the camera, those collapse to a line
+	const vec3 side = cross(tangent, eyePosition - position);
+	const float sideLength = length(side);
+	if (sideLength > 1e-6f)
+		position += side / sideLength * corner.y * 0.5f * width;
+
+	const StrandAttributes attributes = strandAttributes[strand];
+	outAttributes.fragPosition = position;
+	outAttributes.tangent = tangent;
+	outAttributes.color = vec4(attributes.color.rgb, attributes.color.a * coverage);
+	outAttributes.curlScale = attributes.curlScale;
+	gl_Position = projection * view * vec4(position, 1.f);
+}
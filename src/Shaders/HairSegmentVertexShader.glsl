@@ -0,0 +1,55 @@
+#version 460 core
+
+// Every vertex is one strand segment, endpoints and their neighbours are pulled from simulation buffers
+layout (std430, binding = 0) readonly buffer HairPosition {
+	float positions[][3];
+};
+
+struct StrandAttributes {
+	vec4 color;
+	float segmentLength;
+	float curlScale;
+	float particleMass;
+	float stiffness;
+};
+
+layout (std430, binding = 4) readonly buffer StrandAttributeBuffer {
+	StrandAttributes strandAttributes[];
+};
+
+out Segment {
+	vec3 previous;
+	vec3 start;
+	vec3 end;
+	vec3 next;
+	vec4 color;
+	float curlScale;
+} outSegment;
+
+uniform mat4 model;
+uniform uint particlesPerStrand;
+
+vec3 getParticlePosition(in uint index)
+{
+	const vec3 position = vec3(positions[index][0], positions[index][1], positions[index][2]);
+	if (index % particlesPerStrand == 0)
+		return vec3(model * vec4(position, 1.f));
+
+	return position;
+}
+
+void main()
+{
+	const uint segmentsPerStrand = particlesPerStrand - 1;
+	const uint strand = gl_VertexID / segmentsPerStrand;
+	const uint segment = gl_VertexID % segmentsPerStrand;
+	const uint particle = strand * particlesPerStrand + segment;
+	outSegment.start = getParticlePosition(particle);
+	outSegment.end = getParticlePosition(particle + 1);
+
+	// Missing neighbours at strand ends are extrapolated, so spline continues in the same direction
+	outSegment.previous = segment > 0 ? getParticlePosition(particle - 1) : 2.f * outSegment.start - outSegment.end;
+	outSegment.next = segment + 1 < segmentsPerStrand ? getParticlePosition(particle + 2) : 2.f * outSegment.end - outSegment.start;
+	outSegment.color = strandAttributes[strand].color;
+	outSegment.curlScale = strandAttributes[strand].curlScale;
+}
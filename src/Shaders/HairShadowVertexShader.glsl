@@ -0,0 +1,23 @@
+#version 460 core
+
+// Every pair of vertices is one strand segment drawn as a line, positions are pulled from simulation buffer
+layout (std430, binding = 0) readonly buffer HairPosition {
+	float positions[][3];
+};
+
+uniform mat4 model;
+uniform mat4 lightViewProjection;
+uniform uint particlesPerStrand;
+
+void main()
+{
+	const uint segmentsPerStrand = particlesPerStrand - 1;
+	const uint segment = gl_VertexID / 2;
+	const uint particle = segment / segmentsPerStrand * particlesPerStrand + segment % segmentsPerStrand + gl_VertexID % 2;
+
+	vec3 position = vec3(positions[particle][0], positions[particle][1], positions[particle][2]);
+	if (particle % particlesPerStrand == 0)
+		position = vec3(model * vec4(position, 1.f));
+
+	gl_Position = lightViewProjection * vec4(position, 1.f);
+}
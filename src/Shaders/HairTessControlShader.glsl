@@ -0,0 +1,40 @@
+#version 460 core
+
+layout (vertices = 1) out;
+
+in Segment {
+	vec3 previous;
+	vec3 start;
+	vec3 end;
+	vec3 next;
+	vec4 color;
+	float curlScale;
+} inSegment[];
+
+out Segment {
+	vec3 previous;
+	vec3 start;
+	vec3 end;
+	vec3 next;
+	vec4 color;
+	float curlScale;
+} outSegment[];
+
+uniform float subdivisionCount = 9.f;
+uniform vec3 eyePosition;
+uniform float lodDistance = 8.f;
+
+void main()
+{
+	outSegment[gl_InvocationID].previous = inSegment[gl_InvocationID].previous;
+	outSegment[gl_InvocationID].start = inSegment[gl_InvocationID].start;
+	outSegment[gl_InvocationID].end = inSegment[gl_InvocationID].end;
+	outSegment[gl_InvocationID].next = inSegment[gl_InvocationID].next;
+	outSegment[gl_InvocationID].color = inSegment[gl_InvocationID].color;
+	outSegment[gl_InvocationID].curlScale = inSegment[gl_InvocationID].curlScale;
+
+	// Single isoline, segments further than lodDistance get proportionally fewer pieces
+	const float distance = length(eyePosition - 0.5f * (inSegment[gl_InvocationID].start + inSegment[gl_InvocationID].end));
+	gl_TessLevelOuter[0] = 1.f;
+	gl_TessLevelOuter[1] = clamp(round(subdivisionCount * lodDistance / max(distance, 1e-3f)), 1.f, subdivisionCount);
+}
@@ -0,0 +1,63 @@
+#version 460 core
+#define TWO_PI 6.28318530718
+
+layout (isolines, equal_spacing) in;
+
+in Segment {
+	vec3 previous;
+	vec3 start;
+	vec3 end;
+	vec3 next;
+	vec4 color;
+	float curlScale;
+} inSegment[];
+
+out Attributes {
+	vec3 fragPosition;
+	vec3 tangent;
+	vec4 color;
+	float curlScale;
+} outAttributes;
+
+invariant gl_Position;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform float curlRadius = 0.05f;
+
+// Uniform Catmull-Rom spline through start and end, tangent is its derivative
+vec3 catmullRom(in vec3 p0, in vec3 p1, in vec3 p2, in vec3 p3, in float t, out vec3 tangent)
+{
+	const vec3 a = 2.f * p1;
+	const vec3 b = p2 - p0;
+	const vec3 c = 2.f * p0 - 5.f * p1 + 4.f * p2 - p3;
+	const vec3 d = 3.f * (p1 - p2) + p3 - p0;
+	tangent = 0.5f * (b + t * (2.f * c + t * 3.f * d));
+	return 0.5f * (a + t * (b + t * (c + t * d)));
+}
+
+void main()
+{
+	// Same helix as HairGeometryShader, one full turn per segment, but around the smooth strand
+	const float t = gl_TessCoord.x;
+	vec3 tangent;
+	vec3 position = catmullRom(inSegment[0].previous, inSegment[0].start, inSegment[0].end, inSegment[0].next, t, tangent);
+	const vec3 segment = tangent;
+
+	const float strandCurlRadius = curlRadius * inSegment[0].curlScale;
+	if (strandCurlRadius != 0.f)
+	{
+		const vec3 hairDirection = normalize(segment);
+		const vec3 uDirection = normalize(cross(hairDirection, vec3(0.f, 1.f, 0.f)));
+		const vec3 vDirection = normalize(cross(hairDirection, uDirection));
+		const float angle = TWO_PI * t;
+		position += strandCurlRadius * (uDirection * cos(angle) + vDirection * sin(angle));
+		tangent += strandCurlRadius * TWO_PI * (vDirection * cos(angle) - uDirection * sin(angle));
+	}
+
+	outAttributes.fragPosition = position;
+	outAttributes.tangent = normalize(tangent);
+	outAttributes.color = inSegment[0].color;
+	outAttributes.curlScale = inSegment[0].curlScale;
+	gl_Position = projection * view * vec4(position, 1.f);
+}
@@ -2,11 +2,27 @@
 
 layout (location = 0) in vec3 inPosition;
 
+struct StrandAttributes {
+	vec4 color;
+	float segmentLength;
+	float curlScale;
+	float particleMass;
+	float stiffness;
+};
+
+layout (std430, binding = 4) readonly buffer StrandAttributeBuffer {
+	StrandAttributes strandAttributes[];
+};
+
 out Attributes {
 	vec3 fragPosition;
 	vec3 tangent;
+	vec4 color;
+	float curlScale;
 } outAttributes;
 
+invariant gl_Position;
+
 uniform mat4 model;
 uniform uint particlesPerStrand;
 
@@ -17,5 +33,8 @@ void main()
 	else
 		outAttributes.fragPosition = inPosition;
 
+	const StrandAttributes strand = strandAttributes[gl_VertexID / particlesPerStrand];
+	outAttributes.color = strand.color;
+	outAttributes.curlScale = strand.curlScale;
 	gl_Position = vec4(outAttributes.fragPosition, 1.f);
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 450 core
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// First level is copied from resolved depth, every other one reduced from the previous level
+uniform sampler2D depth;
+uniform bool firstLevel;
+layout (r32f, binding = 0) uniform readonly image2D source;
+layout (r32f, binding = 1) uniform writeonly image2D destination;
+
+void main(void)
+{
+	const ivec2 coords = ivec2(gl_GlobalInvocationID.xy);
+	const ivec2 size = imageSize(destination);
+	if (any(greaterThanEqual(coords, size)))
+		return;
+
+	if (firstLevel)
+	{
+		imageStore(destination, coords, vec4(texelFetch(depth, coords, 0).r));
+		return;
+	}
+
+	// Last texel in a row or column also covers the odd texel of the source
+	const ivec2 sourceSize = imageSize(source);
+	const ivec2 first = coords * 2;
+	const ivec2 last = min(first + 1 + ivec2(equal(coords, size - 1)) * (sourceSize & 1), sourceSize - 1);
+	float maximumDepth = 0.0;
+	for (int y = first.y; y <= last.y; ++y)
+	{
+		for (int x = first.x; x <= last.x; ++x)
+			maximumDepth = max(maximumDepth, imageLoad(source, ivec2(x, y)).r);
+	}
+
+	imageStore(destination, coords, vec4(maximumDepth));
+}
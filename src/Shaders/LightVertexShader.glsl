@@ -10,6 +10,9 @@ out Attributes {
 	vec2 texCoords;
 } outAttributes;
 
+// Same depth as in depth prepass, which draws with this shader too
+invariant gl_Position;
+
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
@@ -0,0 +1,19 @@
+#version 330 core
+
+in vec2 texCoords;
+
+out vec4 fragColor;
+
+uniform sampler2D accumulation;
+uniform sampler2D revealage;
+
+void main()
+{
+	// Pixels without transparent fragments keep opaque color
+	float totalRevealage = texture(revealage, texCoords).r;
+	if (totalRevealage >= 1.f)
+		discard;
+
+	vec4 sum = texture(accumulation, texCoords);
+	fragColor = vec4(sum.rgb / max(sum.a, 1e-5f), totalRevealage);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+
+out vec2 texCoords;
+
+// Single triangle covering the whole viewport
+void main()
+{
+	texCoords = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(texCoords * 2.f - 1.f, 0.f, 1.f);
+}
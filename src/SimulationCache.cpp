@@ -0,0 +1,264 @@
+#include "SimulationCache.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+	const char cacheMagic[4] = { 'H', 'C', 'C', 'H' };
+
+	void writeVarint(std::vector<uint8_t>& output, int32_t value)
+	{
+		// Zigzag mapping keeps small negative differences small
+		uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+		while (zigzag >= 0x80)
+		{
+			output.push_back(uint8_t(zigzag | 0x80));
+			zigzag >>= 7;
+		}
+		output.push_back(uint8_t(zigzag));
+	}
+
+	// Returns false if the varint doesn't end before end or is longer than 5 bytes
+	bool readVarint(const uint8_t*& input, const uint8_t* end, int32_t& value)
+	{
+		uint32_t zigzag = 0;
+		for (uint32_t shift = 0; shift < 35; shift += 7)
+		{
+			if (input == end)
+				return false;
+
+			const uint8_t byte = *input++;
+			zigzag |= uint32_t(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+			{
+				value = int32_t(zigzag >> 1) ^ -int32_t(zigzag & 1);
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+SimulationCacheRecorder::SimulationCacheRecorder(const std::string& fileName, uint32_t strandCount, uint32_t particlesPerStrand,
+	uint32_t keyframeInterval, float quantizationStep) : file(fileName, std::ios::binary)
+{
+	if (!file)
+		std::cout << "Failed to open '" << fileName << "' for writing!" << std::endl;
+
+	std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = SimulationCache::currentVersion;
+	header.strandCount = strandCount;
+	header.particlesPerStrand = particlesPerStrand;
+	header.keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+	header.quantizationStep = quantizationStep;
+	file.write((const char*)&header, sizeof(header));
+
+	const size_t floatCount = (size_t)strandCount * particlesPerStrand * 3;
+	previousFrame.resize(floatCount);
+	currentFrame.resize(floatCount);
+	payload.reserve(floatCount * sizeof(int32_t));
+
+	const GLbitfield mappingFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	for (auto& staging : stagingBuffers)
+	{
+		glGenBuffers(1, &staging.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, staging.buffer);
+		glBufferStorage(GL_COPY_WRITE_BUFFER, floatCount * sizeof(float), nullptr, mappingFlags);
+		staging.mappedData = (const float*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, floatCount * sizeof(float), mappingFlags);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+}
+
+SimulationCacheRecorder::~SimulationCacheRecorder()
+{
+	writeReadyFrames(true);
+
+	for (auto& staging : stagingBuffers)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, staging.buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glDeleteBuffers(1, &staging.buffer);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+
+	// Frame offset table is 8 byte aligned, so player can read it in place from mapped file
+	const char padding[8] = {};
+	uint64_t position = (uint64_t)file.tellp();
+	file.write(padding, (8 - position % 8) % 8);
+	header.indexOffset = (uint64_t)file.tellp();
+	file.write((const char*)frameOffsets.data(), frameOffsets.size() * sizeof(uint64_t));
+
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+	std::cout << "Recorded " << header.frameCount << " frames to simulation cache" << std::endl;
+}
+
+void SimulationCacheRecorder::capture(GLuint positionBuffer)
+{
+	// All staging buffers are still in flight, oldest one has to be written before reusing it
+	if (pendingFrames == stagingBuffers.size())
+		writeReadyFrames(true);
+
+	StagingBuffer& staging = stagingBuffers[nextStagingBuffer];
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_COPY_READ_BUFFER, positionBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, staging.buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, currentFrame.size() * sizeof(float));
+	glBindBuffer(GL_COPY_READ_BUFFER, GL_NONE);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+	staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	nextStagingBuffer = (nextStagingBuffer + 1) % stagingBuffers.size();
+	++pendingFrames;
+	writeReadyFrames(false);
+}
+
+void SimulationCacheRecorder::writeReadyFrames(bool waitForGpu)
+{
+	while (pendingFrames > 0)
+	{
+		const uint32_t oldest = (nextStagingBuffer + (uint32_t)stagingBuffers.size() - pendingFrames) % stagingBuffers.size();
+		StagingBuffer& staging = stagingBuffers[oldest];
+
+		// Only the oldest frame is waited for, newer ones are left for later captures
+		GLenum status = glClientWaitSync(staging.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (waitForGpu && status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(staging.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+		if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+			return;
+
+		glDeleteSync(staging.fence);
+		staging.fence = nullptr;
+		encodeFrame(staging.mappedData);
+		--pendingFrames;
+	}
+}
+
+void SimulationCacheRecorder::encodeFrame(const float* positions)
+{
+	for (size_t i = 0; i < currentFrame.size(); ++i)
+		currentFrame[i] = (int32_t)std::lround(positions[i] / header.quantizationStep);
+
+	SimulationCache::FrameHeader frameHeader;
+	frameHeader.keyframe = header.frameCount % header.keyframeInterval == 0;
+
+	payload.clear();
+	if (frameHeader.keyframe)
+	{
+		payload.resize(currentFrame.size() * sizeof(int32_t));
+		std::memcpy(payload.data(), currentFrame.data(), payload.size());
+	}
+	else
+	{
+		for (size_t i = 0; i < currentFrame.size(); ++i)
+			writeVarint(payload, currentFrame[i] - previousFrame[i]);
+	}
+
+	frameHeader.payloadSize = (uint32_t)payload.size();
+	frameOffsets.push_back((uint64_t)file.tellp());
+	file.write((const char*)&frameHeader, sizeof(frameHeader));
+	file.write((const char*)payload.data(), payload.size());
+
+	previousFrame.swap(currentFrame);
+	++header.frameCount;
+}
+
+SimulationCachePlayer::SimulationCachePlayer(const std::string& fileName) : file(fileName)
+{
+	if (!file.isOpen())
+	{
+		std::cout << "Simulation cache '" << fileName << "' doesn't exist!" << std::endl;
+		return;
+	}
+
+	const auto* mappedHeader = reinterpret_cast<const SimulationCache::Header*>(file.getData());
+	if (file.getSize() < sizeof(SimulationCache::Header) || std::memcmp(mappedHeader->magic, cacheMagic, sizeof(cacheMagic)) != 0
+		|| mappedHeader->version != SimulationCache::currentVersion || mappedHeader->keyframeInterval == 0)
+	{
+		std::cout << "File '" << fileName << "' is not a valid simulation cache!" << std::endl;
+		return;
+	}
+
+	if (mappedHeader->indexOffset > file.getSize()
+		|| (uint64_t)mappedHeader->frameCount * sizeof(uint64_t) > file.getSize() - mappedHeader->indexOffset)
+	{
+		std::cout << "Simulation cache '" << fileName << "' is truncated!" << std::endl;
+		return;
+	}
+
+	header = mappedHeader;
+	frameOffsets = reinterpret_cast<const uint64_t*>(file.getData() + header->indexOffset);
+	decodedFrame.resize((size_t)header->strandCount * header->particlesPerStrand * 3);
+}
+
+bool SimulationCachePlayer::decodeFrame(uint32_t frame)
+{
+	// Frame header and payload of a truncated or corrupted cache may point past the end of the file
+	const uint64_t frameOffset = frameOffsets[frame];
+	if (frameOffset > file.getSize() || file.getSize() - frameOffset < sizeof(SimulationCache::FrameHeader))
+		return false;
+
+	const uint8_t* frameStart = file.getData() + frameOffset;
+	SimulationCache::FrameHeader frameHeader;
+	std::memcpy(&frameHeader, frameStart, sizeof(frameHeader));
+	if (frameHeader.payloadSize > file.getSize() - frameOffset - sizeof(frameHeader))
+		return false;
+
+	const uint8_t* input = frameStart + sizeof(frameHeader);
+	const uint8_t* payloadEnd = input + frameHeader.payloadSize;
+	if (frameHeader.keyframe)
+	{
+		if (frameHeader.payloadSize != decodedFrame.size() * sizeof(int32_t))
+			return false;
+
+		std::memcpy(decodedFrame.data(), input, decodedFrame.size() * sizeof(int32_t));
+	}
+	else
+	{
+		// Delta frames are only valid on top of the previous frame
+		if (decodedFrameIndex != (int64_t)frame - 1)
+			return false;
+
+		for (size_t i = 0; i < decodedFrame.size(); ++i)
+		{
+			int32_t difference;
+			if (!readVarint(input, payloadEnd, difference))
+			{
+				// Partially decoded frame is no longer a base for following delta frames
+				decodedFrameIndex = -1;
+				return false;
+			}
+
+			decodedFrame[i] += difference;
+		}
+	}
+
+	decodedFrameIndex = frame;
+	return true;
+}
+
+bool SimulationCachePlayer::readFrame(uint32_t frame, std::vector<float>& positions)
+{
+	if (!isValid() || frame >= header->frameCount)
+		return false;
+
+	if (decodedFrameIndex != frame)
+	{
+		uint32_t firstFrame = frame - frame % header->keyframeInterval;
+		if (decodedFrameIndex >= firstFrame && decodedFrameIndex < frame)
+			firstFrame = (uint32_t)decodedFrameIndex + 1;
+
+		for (uint32_t i = firstFrame; i <= frame; ++i)
+		{
+			if (!decodeFrame(i))
+				return false;
+		}
+	}
+
+	positions.resize(decodedFrame.size());
+	for (size_t i = 0; i < decodedFrame.size(); ++i)
+		positions[i] = decodedFrame[i] * header->quantizationStep;
+
+	return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <glad/glad.h>
+#include "MappedFile.h"
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+* On-disk sequence of simulated particle positions.
+* Positions are quantized to a fixed step. Every keyframeInterval-th frame stores quantized positions directly,
+* frames in between store zigzag varint encoded differences to the previous frame. Frame offsets are indexed at
+* the end of the file, so player can seek to the nearest keyframe and decode forward from there.
+*/
+namespace SimulationCache {
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t strandCount;
+		uint32_t particlesPerStrand;
+		uint32_t keyframeInterval;
+		float quantizationStep;
+		uint32_t frameCount;
+		uint32_t padding;
+		uint64_t indexOffset;			// Byte offset of frame offset table
+	};
+
+	struct FrameHeader {
+		uint32_t keyframe;
+		uint32_t payloadSize;
+	};
+
+	constexpr uint32_t currentVersion = 1;
+}
+
+/*
+* Records position buffer every captured step without stalling the simulation.
+* Buffer is copied into one of persistently mapped staging buffers on GPU and guarded with a fence,
+* data is encoded only once GPU signals the fence, which usually happens a few frames later.
+*/
+class SimulationCacheRecorder {
+public:
+	SimulationCacheRecorder(const std::string& fileName, uint32_t strandCount, uint32_t particlesPerStrand,
+		uint32_t keyframeInterval = 30, float quantizationStep = 1e-4f);
+	~SimulationCacheRecorder();
+	SimulationCacheRecorder(const SimulationCacheRecorder&) = delete;
+	SimulationCacheRecorder& operator=(const SimulationCacheRecorder&) = delete;
+	void capture(GLuint positionBuffer);
+	uint32_t getRecordedFrameCount() const { return header.frameCount; }
+
+private:
+	struct StagingBuffer {
+		GLuint buffer = GL_NONE;
+		const float* mappedData = nullptr;
+		GLsync fence = nullptr;
+	};
+
+	void writeReadyFrames(bool waitForGpu);
+	void encodeFrame(const float* positions);
+	std::ofstream file;
+	SimulationCache::Header header{};
+	std::array<StagingBuffer, 3> stagingBuffers;
+	uint32_t nextStagingBuffer = 0;
+	uint32_t pendingFrames = 0;
+	std::vector<int32_t> previousFrame;
+	std::vector<int32_t> currentFrame;
+	std::vector<uint8_t> payload;
+	std::vector<uint64_t> frameOffsets;
+};
+
+class SimulationCachePlayer {
+public:
+	SimulationCachePlayer(const std::string& fileName);
+	bool isValid() const { return header != nullptr; }
+	uint32_t getFrameCount() const { return header->frameCount; }
+	uint32_t getStrandCount() const { return header->strandCount; }
+	uint32_t getParticlesPerStrand() const { return header->particlesPerStrand; }
+
+	/*
+	* Decodes positions of the requested frame, 3 floats per particle.
+	* Sequential reads decode a single frame, random reads decode from the nearest preceding keyframe.
+	*/
+	bool readFrame(uint32_t frame, std::vector<float>& positions);
+
+private:
+	bool decodeFrame(uint32_t frame);
+	MappedFile file;
+	const SimulationCache::Header* header = nullptr;
+	const uint64_t* frameOffsets = nullptr;
+	std::vector<int32_t> decodedFrame;
+	int64_t decodedFrameIndex = -1;
+};
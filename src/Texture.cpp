@@ -23,7 +23,7 @@ Texture::Texture(const std::string& texName, GLuint texType, const bool gammaCor
 
 Texture::~Texture()
 {
-	glDeleteBuffers(1, &textureID);
+	glDeleteTextures(1, &textureID);
 }
 
 void Texture::activateAndBind(const GLuint textureUnit) const
@@ -73,6 +73,11 @@ void Texture::generate2DMap(const std::string& name, const bool gammaCorrection)
 	int width, height, nrChannels;
 	stbi_set_flip_vertically_on_load(true);
 	unsigned char* data = stbi_load((TEXTURE_FOLDER + name).c_str(), &width, &height, &nrChannels, 0);
+	if (!data)
+	{
+		std::cout << "Texture '" << name << "' couldn't be loaded" << std::endl;
+		return;
+	}
 
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
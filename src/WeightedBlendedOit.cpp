@@ -0,0 +1,140 @@
+#include "WeightedBlendedOit.h"
+#include <glm/glm.hpp>
+
+WeightedBlendedOit::WeightedBlendedOit() :
+	compositeProgram("OitCompositeVertexShader.glsl", "OitCompositeFragmentShader.glsl")
+{
+	glCreateVertexArrays(1, &emptyVao);
+}
+
+WeightedBlendedOit::~WeightedBlendedOit()
+{
+	release();
+	glDeleteVertexArrays(1, &emptyVao);
+}
+
+void WeightedBlendedOit::setResolutionScale(float scale)
+{
+	resolutionScale = glm::clamp(scale, 0.25f, 1.f);
+}
+
+size_t WeightedBlendedOit::getMemoryUsage() const
+{
+	// RGBA16F color, R16F revealage and packed depth at scaled resolution, plus full resolution resolved depth
+	const size_t scaledPixels = (size_t)width * height;
+	const size_t viewportPixels = (size_t)viewport[2] * viewport[3];
+	return scaledPixels * (8 + 2 + 4) + (resolveDepth != GL_NONE ? viewportPixels * 4 : 0);
+}
+
+void WeightedBlendedOit::begin()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	blendEnabled = glIsEnabled(GL_BLEND);
+	resize(viewport[2], viewport[3]);
+
+	// Opaque depth is resolved at full resolution first and then scaled down
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, targetFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer);
+	glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+		0, 0, viewport[2], viewport[3], GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, accumulationFramebuffer);
+	glBlitFramebuffer(0, 0, viewport[2], viewport[3], 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	const GLfloat clearAccumulation[4] = { 0.f, 0.f, 0.f, 0.f };
+	const GLfloat clearRevealage[4] = { 1.f, 0.f, 0.f, 0.f };
+	glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+	glClearBufferfv(GL_COLOR, 1, clearRevealage);
+
+	// Color sum is additive, revealage is product of (1 - alpha) of all fragments
+	glViewport(0, 0, width, height);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFunci(0, GL_ONE, GL_ONE);
+	glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+void WeightedBlendedOit::end() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	// Average color is blended over opaque scene by total revealage
+	glDisable(GL_DEPTH_TEST);
+	glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+	compositeProgram.use();
+	compositeProgram.setInt("accumulation", 0);
+	compositeProgram.setInt("revealage", 1);
+	glBindTextureUnit(0, accumulationTexture);
+	glBindTextureUnit(1, revealageTexture);
+	glBindVertexArray(emptyVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(GL_NONE);
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	if (!blendEnabled)
+		glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+}
+
+void WeightedBlendedOit::resize(GLsizei viewportWidth, GLsizei viewportHeight)
+{
+	const GLsizei scaledWidth = glm::max(1, (GLsizei)(viewportWidth * resolutionScale));
+	const GLsizei scaledHeight = glm::max(1, (GLsizei)(viewportHeight * resolutionScale));
+	GLint resolveWidth = 0, resolveHeight = 0;
+	if (resolveDepth != GL_NONE)
+	{
+		glGetNamedRenderbufferParameteriv(resolveDepth, GL_RENDERBUFFER_WIDTH, &resolveWidth);
+		glGetNamedRenderbufferParameteriv(resolveDepth, GL_RENDERBUFFER_HEIGHT, &resolveHeight);
+	}
+
+	if (scaledWidth == width && scaledHeight == height && resolveWidth == viewportWidth && resolveHeight == viewportHeight)
+		return;
+
+	release();
+	width = scaledWidth;
+	height = scaledHeight;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &accumulationTexture);
+	glTextureStorage2D(accumulationTexture, 1, GL_RGBA16F, width, height);
+	glCreateTextures(GL_TEXTURE_2D, 1, &revealageTexture);
+	glTextureStorage2D(revealageTexture, 1, GL_R16F, width, height);
+	for (GLuint texture : { accumulationTexture, revealageTexture })
+	{
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	// Depth blits need the same format as default framebuffer, which is packed 24-bit depth and 8-bit stencil
+	glCreateRenderbuffers(1, &accumulationDepth);
+	glNamedRenderbufferStorage(accumulationDepth, GL_DEPTH24_STENCIL8, width, height);
+	glCreateFramebuffers(1, &accumulationFramebuffer);
+	glNamedFramebufferTexture(accumulationFramebuffer, GL_COLOR_ATTACHMENT0, accumulationTexture, 0);
+	glNamedFramebufferTexture(accumulationFramebuffer, GL_COLOR_ATTACHMENT1, revealageTexture, 0);
+	glNamedFramebufferRenderbuffer(accumulationFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, accumulationDepth);
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(accumulationFramebuffer, 2, drawBuffers);
+
+	glCreateRenderbuffers(1, &resolveDepth);
+	glNamedRenderbufferStorage(resolveDepth, GL_DEPTH24_STENCIL8, viewportWidth, viewportHeight);
+	glCreateFramebuffers(1, &resolveFramebuffer);
+	glNamedFramebufferRenderbuffer(resolveFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, resolveDepth);
+}
+
+void WeightedBlendedOit::release()
+{
+	glDeleteFramebuffers(1, &accumulationFramebuffer);
+	glDeleteFramebuffers(1, &resolveFramebuffer);
+	glDeleteTextures(1, &accumulationTexture);
+	glDeleteTextures(1, &revealageTexture);
+	glDeleteRenderbuffers(1, &accumulationDepth);
+	glDeleteRenderbuffers(1, &resolveDepth);
+	accumulationFramebuffer = resolveFramebuffer = GL_NONE;
+	accumulationTexture = revealageTexture = GL_NONE;
+	accumulationDepth = resolveDepth = GL_NONE;
+	width = height = 0;
+}
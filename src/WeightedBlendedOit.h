@@ -0,0 +1,45 @@
+#pragma once
+#include "DrawingShader.h"
+#include <glad/glad.h>
+
+/*
+* Weighted blended order-independent transparency.
+* Transparent geometry drawn between begin() and end() is accumulated into RGBA16F premultiplied color sum and
+* R16F revealage instead of the bound framebuffer, end() composites the average color over it.
+* Opaque depth is copied from the bound framebuffer, so transparent fragments behind opaque geometry are rejected.
+* Buffers are at most resolution scale squared times viewport size, 10 bytes plus a depth value per pixel.
+*/
+class WeightedBlendedOit {
+public:
+	WeightedBlendedOit();
+	~WeightedBlendedOit();
+	WeightedBlendedOit(const WeightedBlendedOit&) = delete;
+	WeightedBlendedOit& operator=(const WeightedBlendedOit&) = delete;
+
+	// Sets size of accumulation buffers relative to viewport, clamped in range [0.25, 1]
+	void setResolutionScale(float scale);
+	float getResolutionScale() const { return resolutionScale; }
+
+	// GPU memory currently held by accumulation and depth buffers in bytes
+	size_t getMemoryUsage() const;
+	void begin();
+	void end() const;
+
+private:
+	void resize(GLsizei viewportWidth, GLsizei viewportHeight);
+	void release();
+	DrawingShader compositeProgram;
+	GLuint emptyVao = GL_NONE;
+	GLuint accumulationFramebuffer = GL_NONE;
+	GLuint accumulationTexture = GL_NONE;
+	GLuint revealageTexture = GL_NONE;
+	GLuint accumulationDepth = GL_NONE;
+	GLuint resolveFramebuffer = GL_NONE;		// Single sampled copy of multisampled opaque depth, blits can't resolve and scale at once
+	GLuint resolveDepth = GL_NONE;
+	GLint targetFramebuffer = 0;
+	GLint viewport[4] = {};
+	GLboolean blendEnabled = GL_FALSE;		// Blend state of the caller, restored by end()
+	GLsizei width = 0;
+	GLsizei height = 0;
+	float resolutionScale = 1.f;
+};
@@ -2,7 +2,7 @@
 #include "Window.h"
 #include <glm/common.hpp>
 
-Window::Window(uint32_t winWidth, uint32_t winHeight, const char* winName, int sampleCount)
+Window::Window(uint32_t winWidth, uint32_t winHeight, const char* winName, int sampleCount, bool visible)
 {
 	GLFWwindow* window = nullptr;
 
@@ -11,6 +11,7 @@ Window::Window(uint32_t winWidth, uint32_t winHeight, const char* winName, int s
 		std::cerr << "Failed to initialize GLFW!" << std::endl;
 
 	glfwWindowHint(GLFW_SAMPLES, sampleCount);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 	/* Create a windowed mode window and its OpenGL context */
 	window = glfwCreateWindow(winWidth, winHeight, winName, NULL, NULL);
 	if (!window)
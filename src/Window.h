@@ -4,6 +4,7 @@
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
+#include <string>
 #include <unordered_map>
 
 struct Time {
@@ -15,7 +16,7 @@ struct Time {
 
 class Window {
 public:
-	Window(uint32_t winWidth = 1024, uint32_t winHeight = 768, const char* winName = "MyApplication", int sampleCount = 1);
+	Window(uint32_t winWidth = 1024, uint32_t winHeight = 768, const char* winName = "MyApplication", int sampleCount = 1, bool visible = true);
 	~Window();
 	void onUpdate();
 	glm::vec2 getCursorOffset() const;
@@ -25,6 +26,7 @@ public:
 	bool isKeyTapped(int key) const;
 	bool isMouseButtonPressed(int key) const;
 	bool shouldClose() const { return glfwWindowShouldClose(windowHandle); }
+	void setTitle(const std::string& title) { glfwSetWindowTitle(windowHandle, title.c_str()); }
 	const Time& getTime() const { return t; }
 	const bool isResized() const { return resized; }
 
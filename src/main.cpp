@@ -6,16 +6,48 @@
 #include "Cube.h"
 #include "Hair.h"
 #include "DrawingShader.h"
+#include "HairRenderer.h"
+#include "HairSystem.h"
+#include "SimulationCache.h"
 #include <glm/gtc/matrix_access.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include <array>
+#include <string>
 
 template<typename T> using Unique = std::unique_ptr<T>;
 
-int main(void)
+int main(int argc, char** argv)
 {
+	// Optional checkpoint to restore hair from, it is also where F5 saves current state
+	std::string checkpointFile = "hair.checkpoint";
+	bool restoreCheckpoint = false;
+	std::string recordFile, playFile;
+	uint32_t crowdSize = 0;
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		if (argument == "--checkpoint")
+		{
+			checkpointFile = argv[++i];
+			restoreCheckpoint = true;
+		}
+		else if (argument == "--record")
+		{
+			recordFile = argv[++i];
+		}
+		else if (argument == "--play")
+		{
+			playFile = argv[++i];
+		}
+		else if (argument == "--crowd")
+		{
+			crowdSize = std::stoul(argv[++i]);
+		}
+	}
+
 	Unique<Window> window = std::make_unique<Window>(1440, 810, "Hair Simulation", 4);
 	glEnable(GL_MULTISAMPLE);
 	glEnable(GL_DEPTH_TEST);
@@ -39,14 +71,50 @@ int main(void)
 	Texture skyboxCubemap("room.png", GL_TEXTURE_CUBE_MAP, false);
 
 	// Basic hair
-	Unique<Hair> hair = std::make_unique<Hair>(2000, 4.f, 0.f);
+	Unique<Hair> hair = restoreCheckpoint ? std::make_unique<Hair>(checkpointFile) : std::make_unique<Hair>(2000, 4.f, 0.f);
 	hair->color = glm::vec3(0.45f, 0.18f, 0.012f);
 
+	// Optional crowd of heads on a square grid behind the main hair, all simulated and drawn as one hair system
+	Unique<HairSystem> crowd;
+	if (crowdSize > 0)
+	{
+		const uint32_t rowLength = (uint32_t)glm::ceil(glm::sqrt((float)crowdSize));
+		std::vector<glm::mat4> crowdTransforms;
+		for (uint32_t i = 0; i < crowdSize; ++i)
+		{
+			const glm::vec3 position(((float)(i % rowLength) - 0.5f * (rowLength - 1)) * 8.f, 0.f, -8.f * (float)(i / rowLength + 1));
+			crowdTransforms.push_back(glm::translate(glm::mat4(1.f), position));
+		}
+
+		crowd = std::make_unique<HairSystem>(crowdTransforms, 2000, 4.f, 0.f);
+		crowd->getPrototype().color = hair->color;
+		crowd->setCulledSimulationInterval(4);
+	}
+
+	// Simulation cache recording or playback, playback replaces physics
+	Unique<SimulationCacheRecorder> cacheRecorder;
+	Unique<SimulationCachePlayer> cachePlayer;
+	std::vector<float> playbackPositions;
+	uint32_t playbackFrame = 0;
+	if (!playFile.empty())
+	{
+		cachePlayer = std::make_unique<SimulationCachePlayer>(playFile);
+		if (cachePlayer->isValid() && cachePlayer->getParticlesPerStrand() == hair->getParticlesPerStrand())
+			hair->setStrandCount(cachePlayer->getStrandCount());
+		else
+			cachePlayer.reset();
+	}
+	else if (!recordFile.empty())
+	{
+		cacheRecorder = std::make_unique<SimulationCacheRecorder>(recordFile, hair->getStrandCount(), hair->getParticlesPerStrand());
+	}
+
 	// Shaders setup
 	DrawingShader basicShader("BasicVertexShader.glsl", "BasicFragmentShader.glsl");
 	DrawingShader lightingShader("LightVertexShader.glsl", "LightFragmentShader.glsl");
 	DrawingShader skyboxShader("SkyboxVertexShader.glsl", "SkyboxFragmentShader.glsl");
-	DrawingShader hairShader("HairVertexShader.glsl", "HairGeometryShader.glsl", "HairFragmentShader.glsl");
+	DrawingShader depthShader("LightVertexShader.glsl", "DepthFragmentShader.glsl");
+	HairRenderer hairRenderer;
 
 	// Scene light setup
 	lightingShader.use();
@@ -56,13 +124,6 @@ int main(void)
 	lightingShader.setFloat("light.linear", 0.024f);
 	lightingShader.setFloat("light.quadratic", 0.0021f);
 
-	hairShader.use();
-	hairShader.setVec3("light.position", glm::vec3(glm::column(lightSphere->getTransformMatrix(), 3)));
-	hairShader.setVec3("light.color", lightSphere->color);
-	hairShader.setFloat("light.constant", 1.f);
-	hairShader.setFloat("light.linear", 0.024f);
-	hairShader.setFloat("light.quadratic", 0.0021f);
-
 	bool doPhysics = false;
 
 	enum Control {
@@ -72,7 +133,9 @@ int main(void)
 		HAIR_FRICTION,
 		HAIR_CURLINESS,
 		HAIR_STRAND_COUNT,
-		VELOCITY_DAMPING
+		VELOCITY_DAMPING,
+		HAIR_STRAND_WIDTH,
+		VOLUME_REPULSION
 	};
 
 	/*
@@ -82,21 +145,47 @@ int main(void)
 
 	float angleX = 0.f;
 	float angleY = 0.f;
+	uint32_t shownActiveStrandCount = UINT32_MAX;
 
 	glViewport(0, 0, window->getWindowSize().x, window->getWindowSize().y);
 	do {
-		glDisable(GL_CULL_FACE);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		skyboxShader.use();
-		skyboxShader.setMat4("projection", cam.getProjection());
-		skyboxShader.setMat4("view", cam.getView());
-		skyboxCubemap.activateAndBind(GL_TEXTURE0);
-		skybox->draw();
 
-		if (doPhysics && glm::abs(window->getTime().deltaTime - window->getTime().lastDeltaTime) < 0.1f)
+		if (cachePlayer)
+		{
+			if (doPhysics && cachePlayer->readFrame(playbackFrame, playbackPositions))
+			{
+				hair->uploadPositions(playbackPositions);
+				playbackFrame = (playbackFrame + 1) % cachePlayer->getFrameCount();
+			}
+		}
+		else if (doPhysics && glm::abs(window->getTime().deltaTime - window->getTime().lastDeltaTime) < 0.1f)
+		{
 			hair->applyPhysics(window->getTime().deltaTime, window->getTime().runningTime);
+			if (crowd)
+				crowd->applyPhysics(window->getTime().deltaTime, window->getTime().runningTime);
+
+			if (cacheRecorder)
+				cacheRecorder->capture(hair->getPositionBuffer());
+		}
 
+		// Depth prepass of head and opaque hair, so following shading runs only for visible fragments
 		glEnable(GL_CULL_FACE);
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		depthShader.use();
+		depthShader.setMat4("projection", cam.getProjection());
+		depthShader.setMat4("view", cam.getView());
+		depthShader.setMat4("model", hair->getTransformMatrix());
+		hair->drawHead();
+		for (uint32_t i = 0; crowd && i < crowd->getInstanceCount(); ++i)
+		{
+			depthShader.setMat4("model", crowd->getInstanceTransform(i));
+			crowd->getPrototype().drawHead();
+		}
+
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		hairRenderer.drawDepth(*hair, cam);
+
 		basicShader.use();
 		basicShader.setMat4("projection", cam.getProjection());
 		basicShader.setMat4("view", cam.getView());
@@ -123,19 +212,41 @@ int main(void)
 		glm::vec3 tempColor = hair->color;
 		hair->color = glm::vec3(1.f, 0.576f, 0.229f);
 		hair->updateColorsBasedOnMaterial(lightingShader, Entity::Material::PLASTIC);
+		glDepthFunc(GL_EQUAL);
 		hair->drawHead();
+		for (uint32_t i = 0; crowd && i < crowd->getInstanceCount(); ++i)
+		{
+			lightingShader.setMat4("model", crowd->getInstanceTransform(i));
+			crowd->getPrototype().drawHead();
+		}
+
+		glDepthFunc(GL_LEQUAL);
 
 		hair->color = tempColor;
-		hairShader.use();
-		hairShader.setMat4("projection", cam.getProjection());
-		hairShader.setMat4("view", cam.getView());
-		hairShader.setMat4("model", hair->getTransformMatrix());
-		hairShader.setFloat("curlRadius", hair->getCurlRadius());
-		hairShader.setVec3("eyePosition", cam.getPosition());
-		hairShader.setUint("particlesPerStrand", hair->getParticlesPerStrand());
-		hairShader.setVec3("light.position", glm::vec3(glm::column(lightSphere->getTransformMatrix(), 3)));
-		hair->updateColorsBasedOnMaterial(hairShader, Entity::Material::HAIR);
-		hair->draw();
+		hairRenderer.setLight(glm::vec3(glm::column(lightSphere->getTransformMatrix(), 3)), lightSphere->color);
+		if (!hairRenderer.getOrderIndependentTransparency())
+		{
+			hairRenderer.draw(*hair, cam);
+			if (crowd)
+				hairRenderer.draw(*crowd, cam);
+		}
+
+		// Skybox is at maximum depth, so it's drawn last and only where nothing else was
+		glDisable(GL_CULL_FACE);
+		skyboxShader.use();
+		skyboxShader.setMat4("projection", cam.getProjection());
+		skyboxShader.setMat4("view", cam.getView());
+		skyboxCubemap.activateAndBind(GL_TEXTURE0);
+		skybox->draw();
+
+		// Transparent hair doesn't write depth and has to be blended over the whole scene
+		// Crowd is behind the main hair, so it's composited first
+		if (hairRenderer.getOrderIndependentTransparency())
+		{
+			if (crowd)
+				hairRenderer.draw(*crowd, cam);
+			hairRenderer.draw(*hair, cam);
+		}
 
 		float deltaTime = window->getTime().deltaTime;
 		if (window->isKeyPressed(GLFW_KEY_W))
@@ -154,7 +265,7 @@ int main(void)
 		if (window->isMouseButtonPressed(GLFW_MOUSE_BUTTON_RIGHT))
 			cam.rotateCamera(window->getCursorOffset());
 
-		for (int i = 0; i <= 6; ++i)
+		for (int i = 0; i <= 8; ++i)
 		{
 			if (window->isKeyTapped(i + GLFW_KEY_0))
 			{
@@ -183,6 +294,12 @@ int main(void)
 					case 6:
 						std::cout << "Velocity damping" << std::endl;
 						break;
+					case 7:
+						std::cout << "Hair strand width" << std::endl;
+						break;
+					case 8:
+						std::cout << "Hair volume repulsion" << std::endl;
+						break;
 				}
 				break;
 			}
@@ -271,11 +388,101 @@ int main(void)
 				else if (window->isKeyTapped(GLFW_KEY_DOWN))
 					hair->decreaseVelocityDamping();
 				break;
+
+			case HAIR_STRAND_WIDTH:
+				if (window->isKeyTapped(GLFW_KEY_UP))
+					hair->setStrandWidth(hair->getStrandWidth() + 0.002f);
+				else if (window->isKeyTapped(GLFW_KEY_DOWN))
+					hair->setStrandWidth(hair->getStrandWidth() - 0.002f);
+				break;
+
+			case VOLUME_REPULSION:
+				if (doPhysics && window->isKeyTapped(GLFW_KEY_UP))
+					hair->setVolumeRepulsion(hair->getVolumeRepulsion() + 0.5f);
+				else if (doPhysics && window->isKeyTapped(GLFW_KEY_DOWN))
+					hair->setVolumeRepulsion(hair->getVolumeRepulsion() - 0.5f);
+				break;
 		}
 
 		if (window->isKeyTapped(GLFW_KEY_ENTER))
 			doPhysics = !doPhysics;
 
+		if (window->isKeyTapped(GLFW_KEY_F5))
+			hair->saveCheckpoint(checkpointFile);
+
+		if (window->isKeyTapped(GLFW_KEY_R))
+		{
+			hairRenderer.setMode((HairRenderer::Mode)(((int)hairRenderer.getMode() + 1) % 4));
+			std::cout << "Hair render mode: " << HairRenderer::getModeName(hairRenderer.getMode()) << std::endl;
+		}
+
+		if (window->isKeyTapped(GLFW_KEY_T))
+		{
+			hairRenderer.setOrderIndependentTransparency(!hairRenderer.getOrderIndependentTransparency());
+			std::cout << "Hair transparency: " << (hairRenderer.getOrderIndependentTransparency() ? "on" : "off") << std::endl;
+		}
+
+		if (window->isKeyTapped(GLFW_KEY_H))
+		{
+			hairRenderer.setSelfShadowing(!hairRenderer.getSelfShadowing());
+			std::cout << "Hair self-shadowing: " << (hairRenderer.getSelfShadowing() ? "on" : "off") << std::endl;
+		}
+
+		if (window->isKeyTapped(GLFW_KEY_C))
+		{
+			hairRenderer.setCulling(!hairRenderer.getCulling());
+			std::cout << "Hair culling: " << (hairRenderer.getCulling() ? "on" : "off") << std::endl;
+		}
+
+		if (window->isKeyTapped(GLFW_KEY_L))
+		{
+			hair->setSleeping(!hair->getSleeping());
+			std::cout << "Hair sleeping: " << (hair->getSleeping() ? "on" : "off") << std::endl;
+
+			// All strands are awake right after the switch
+			shownActiveStrandCount = hair->getStrandCount();
+			if (hair->getSleeping())
+				window->setTitle("Hair Simulation - active strands: " + std::to_string(shownActiveStrandCount) + " / " + std::to_string(hair->getStrandCount()));
+			else
+				window->setTitle("Hair Simulation");
+		}
+
+		if (window->isKeyTapped(GLFW_KEY_E))
+		{
+			hair->setDistanceFieldCollision(!hair->getDistanceFieldCollision());
+			std::cout << "Head collision: " << (hair->getDistanceFieldCollision() ? "distance field" : "ellipsoids") << std::endl;
+		}
+
+		if (window->isKeyTapped(GLFW_KEY_V))
+		{
+			hair->setVolumeUpdateInterval(hair->getVolumeUpdateInterval() >= 8 ? 1 : hair->getVolumeUpdateInterval() * 2);
+			std::cout << "Hair voxel field rebuilt every " << hair->getVolumeUpdateInterval() << " steps" << std::endl;
+		}
+
+		if (window->isKeyTapped(GLFW_KEY_P))
+			hair->captureRestShape();
+
+		if (window->isKeyTapped(GLFW_KEY_X))
+		{
+			const bool xpbd = hair->getSolver() == Hair::Solver::XPBD;
+			hair->setSolver(xpbd ? Hair::Solver::FOLLOW_THE_LEADER : Hair::Solver::XPBD);
+			std::cout << "Hair solver: " << (xpbd ? "follow-the-leader" : "XPBD") << std::endl;
+		}
+
+		// Count of simulated strands is shown while still strands can fall asleep
+		if (hair->getSleeping() && hair->getActiveStrandCount() != shownActiveStrandCount)
+		{
+			shownActiveStrandCount = hair->getActiveStrandCount();
+			window->setTitle("Hair Simulation - active strands: " + std::to_string(shownActiveStrandCount) + " / " + std::to_string(hair->getStrandCount()));
+		}
+
+		if (window->isKeyTapped(GLFW_KEY_K))
+		{
+			const bool marschner = hairRenderer.getMaterial() == Entity::Material::HAIR_MARSCHNER;
+			hairRenderer.setMaterial(marschner ? Entity::Material::HAIR : Entity::Material::HAIR_MARSCHNER);
+			std::cout << "Hair shading: " << (marschner ? "Kajiya-Kay" : "Marschner") << std::endl;
+		}
+
 		if (window->isResized())
 		{
 			glm::ivec2 windowSize = window->getWindowSize();